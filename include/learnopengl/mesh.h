@@ -7,7 +7,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/Frustum.h>
+#include <rg/VertexPacking.h>
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 using namespace std;
@@ -33,6 +37,83 @@ struct Texture {
     string path;
 };
 
+// one buffer per vertex attribute, the index in VERTEX_STREAMS is the attribute location.
+// A program only fetches the streams it reads, so split streams serve several programs at once.
+struct VertexStream {
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset; // inside PackedVertex
+    size_t size;
+};
+
+const VertexStream VERTEX_STREAMS[] = {
+        // positions, w is padding
+        {4, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, position), sizeof(PackedVertex::position)},
+        // normals, octahedral
+        {2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal), sizeof(PackedVertex::normal)},
+        // texture coords
+        {2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texCoords), sizeof(PackedVertex::texCoords)}
+};
+const unsigned int VERTEX_STREAM_COUNT = sizeof(VERTEX_STREAMS) / sizeof(VERTEX_STREAMS[0]);
+
+// locations taken by one element of an attribute, a matrix has one per column
+inline int AttributeLocations(GLenum type)
+{
+    switch (type) {
+        case GL_FLOAT_MAT2: case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: return 2;
+        case GL_FLOAT_MAT3: case GL_FLOAT_MAT3x2: case GL_FLOAT_MAT3x4: return 3;
+        case GL_FLOAT_MAT4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3: return 4;
+        default: return 1;
+    }
+}
+
+// bit i is set when the linked program reads attribute location i
+inline unsigned int ConsumedAttributes(unsigned int program)
+{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+
+    vector<char> name(maxLength + 1);
+    unsigned int mask = 0;
+    for (GLint i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(program, i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+        // built-ins like gl_VertexID are active too, but have no location
+        GLint location = glGetAttribLocation(program, name.data());
+        if (location < 0)
+            continue;
+        // arrays and matrices cover the consecutive locations after their first one
+        int locations = AttributeLocations(type) * size;
+        for (int l = location; l < location + locations && l < 32; l++)
+            mask |= 1u << l;
+    }
+    return mask;
+}
+
+// what a mesh keeps on the CPU once its buffers are on the GPU
+enum MeshResidency {
+    DROP_AFTER_UPLOAD, // only bounds and draw ranges stay
+    KEEP_FULL,         // fp32 vertices and 32 bit indices, e.g. for collision
+    KEEP_COMPRESSED    // the packed GPU vertices and 16 bit indices, enough for picking
+};
+
+// one level of detail, a range of the mesh index buffer
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+};
+
+// a piece of a detail level whose indices fit in 16 bits relative to baseVertex
+struct IndexChunk {
+    unsigned int indexOffset; // into the GPU index buffer
+    unsigned int indexCount;
+    int baseVertex;
+};
+
 class Mesh {
 public:
     // mesh Data
@@ -40,17 +121,157 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
+    unsigned int VAO = 0;
+    // attribute locations that have a stream on the GPU
+    unsigned int attributeMask = 0;
     std::string glslIdentifierPrefix;
+    // object space bounds, the packed positions are quantised inside aabb
+    AABB aabb;
+    BoundingSphere sphere;
+    // detail levels from the full mesh down, all of them index the same vertices
+    vector<MeshLod> lods;
+    unsigned int lod = 0;
+    // what each detail level draws from the GPU index buffer
+    vector<vector<IndexChunk>> chunks;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    MeshResidency residency = KEEP_FULL;
+    // bytes of vertex streams and indices uploaded
+    size_t gpuBytes = 0;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, vector<MeshLod> lods = vector<MeshLod>())
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->lods = lods;
+        if (this->lods.empty())
+            this->lods.push_back({0, (unsigned int)indices.size(), 0.0f});
+
+        computeBounds();
+    }
+
+    // uploads the indices and only the vertex streams in attributeMask (see ConsumedAttributes),
+    // then releases the CPU copies residency does not ask for
+    void Upload(unsigned int attributeMask, MeshResidency residency = DROP_AFTER_UPLOAD)
+    {
+        this->attributeMask = attributeMask;
+        this->residency = residency;
+        gpuBytes = 0;
+
+        // the GPU gets the quantised layout, the fp32 vertices stay on the CPU side
+        vector<PackedVertex> packed(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++) {
+            const Vertex &v = vertices[i];
+            packed[i] = VertexPacker::pack(v.Position, v.Normal, v.TexCoords, aabb);
+        }
+
+        // create buffers/arrays
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &EBO);
+
+        // 16 bit indices whenever every level splits into chunks of at most 65536 vertices,
+        // 32 bit only when a single triangle spans more than that
+        vector<uint16_t> shortIndices;
+        chunks.assign(lods.size(), vector<IndexChunk>());
+        bool fits = true;
+        for (unsigned int i = 0; i < lods.size() && fits; i++)
+            fits = appendChunks(&indices[lods[i].indexOffset], lods[i].indexCount, shortIndices, chunks[i]);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (fits) {
+            indexType = GL_UNSIGNED_SHORT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), &shortIndices[0], GL_STATIC_DRAW);
+            gpuBytes += shortIndices.size() * sizeof(uint16_t);
+        } else {
+            indexType = GL_UNSIGNED_INT;
+            for (unsigned int i = 0; i < lods.size(); i++)
+                chunks[i].assign(1, IndexChunk{lods[i].indexOffset, lods[i].indexCount, 0});
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+            gpuBytes += indices.size() * sizeof(unsigned int);
+        }
+
+        vector<unsigned char> stream;
+        for (unsigned int location = 0; location < VERTEX_STREAM_COUNT; location++) {
+            if (!(attributeMask & (1u << location)))
+                continue;
+
+            // gather this attribute out of the packed vertices into its own tightly packed buffer
+            const VertexStream &layout = VERTEX_STREAMS[location];
+            stream.resize(packed.size() * layout.size);
+            for (size_t i = 0; i < packed.size(); i++)
+                memcpy(&stream[i * layout.size], (const unsigned char *)&packed[i] + layout.offset, layout.size);
+
+            glGenBuffers(1, &streams[location]);
+            glBindBuffer(GL_ARRAY_BUFFER, streams[location]);
+            glBufferData(GL_ARRAY_BUFFER, stream.size(), stream.data(), GL_STATIC_DRAW);
+            gpuBytes += stream.size();
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, layout.components, layout.type, layout.normalized, (GLsizei)layout.size, (void*)0);
+        }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        glBindVertexArray(0);
+
+        if (residency == KEEP_COMPRESSED) {
+            packedVertices.swap(packed);
+            if (indexType == GL_UNSIGNED_SHORT) {
+                compressedIndices.swap(shortIndices);
+                vector<unsigned int>().swap(indices);
+            }
+        }
+        if (residency != KEEP_FULL) {
+            vector<Vertex>().swap(vertices);
+            if (residency == DROP_AFTER_UPLOAD)
+                vector<unsigned int>().swap(indices);
+        }
+    }
+
+    // number of indices of the full detail level that can still be read on the CPU
+    unsigned int CpuIndexCount() const
+    {
+        return indices.empty() && compressedIndices.empty() ? 0 : lods[0].indexCount;
+    }
+
+    // vertex index i of the full detail level, works with both kept layouts
+    unsigned int CpuIndex(unsigned int i) const
+    {
+        if (!indices.empty())
+            return indices[lods[0].indexOffset + i];
+
+        // the compressed indices are the GPU chunks, the full level's chunks cover it in order
+        for (const IndexChunk &chunk : chunks[0]) {
+            if (i < chunk.indexCount)
+                return compressedIndices[chunk.indexOffset + i] + chunk.baseVertex;
+            i -= chunk.indexCount;
+        }
+        return 0;
+    }
+
+    // object space position of vertex i, decoded from the packed vertices when only those were kept
+    glm::vec3 CpuPosition(unsigned int i) const
+    {
+        if (!vertices.empty())
+            return vertices[i].Position;
+
+        const uint16_t *p = packedVertices[i].position;
+        glm::vec3 t(p[0] / 65535.0f, p[1] / 65535.0f, p[2] / 65535.0f);
+        return VertexPacker::positionOffset(aabb) + t * VertexPacker::positionScale(aabb);
+    }
+
+    // heap memory held on the CPU side
+    size_t CpuBytes() const
+    {
+        size_t bytes = vertices.capacity() * sizeof(Vertex)
+                     + indices.capacity() * sizeof(unsigned int)
+                     + packedVertices.capacity() * sizeof(PackedVertex)
+                     + compressedIndices.capacity() * sizeof(uint16_t)
+                     + textures.capacity() * sizeof(Texture)
+                     + lods.capacity() * sizeof(MeshLod);
+        for (const Texture &texture : textures)
+            bytes += texture.type.capacity() + texture.path.capacity();
+        for (const vector<IndexChunk> &levelChunks : chunks)
+            bytes += levelChunks.capacity() * sizeof(IndexChunk);
+        return bytes;
     }
 
     // render the mesh
@@ -84,56 +305,78 @@ public:
 
 
 
+        // undo the position quantisation
+        shader.setVec3("positionOffset", VertexPacker::positionOffset(aabb));
+        shader.setVec3("positionScale", VertexPacker::positionScale(aabb));
+
         // draw mesh
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        for (const IndexChunk &chunk : chunks[lod])
+            glDrawElementsBaseVertex(GL_TRIANGLES, chunk.indexCount, indexType, (void*)(chunk.indexOffset * indexSize), chunk.baseVertex);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    unsigned int TriangleCount() const
+    {
+        return lods[lod].indexCount / 3;
+    }
+
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int streams[VERTEX_STREAM_COUNT] = {};
+    unsigned int EBO = 0;
+
+    // CPU copies kept by KEEP_COMPRESSED
+    vector<PackedVertex> packedVertices;
+    vector<uint16_t> compressedIndices;
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // Greedily cuts the triangles of a level into runs whose vertices are at most 65535 apart and
+    // appends them as 16 bit offsets from the smallest vertex of the run. Vertices are stored in
+    // first use order, so consecutive triangles stay close. False if a triangle alone spans too far.
+    static bool appendChunks(const unsigned int *levelIndices, unsigned int count, vector<uint16_t> &out, vector<IndexChunk> &levelChunks)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        unsigned int begin = 0;
+        while (begin < count) {
+            unsigned int low = ~0u, high = 0;
+            unsigned int end = begin;
+            for (; end + 3 <= count; end += 3) {
+                const unsigned int *t = levelIndices + end;
+                unsigned int newLow = std::min(low, std::min(t[0], std::min(t[1], t[2])));
+                unsigned int newHigh = std::max(high, std::max(t[0], std::max(t[1], t[2])));
+                if (newHigh - newLow > 0xFFFF)
+                    break;
+                low = newLow;
+                high = newHigh;
+            }
+            if (end == begin)
+                return false;
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+            levelChunks.push_back({(unsigned int)out.size(), end - begin, (int)low});
+            for (unsigned int i = begin; i < end; i++)
+                out.push_back((uint16_t)(levelIndices[i] - low));
+            begin = end;
+        }
+        return true;
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    // axis aligned box around the vertices and a sphere around the box center that still contains all of them
+    void computeBounds()
+    {
+        if (vertices.empty())
+            return;
 
-        glBindVertexArray(0);
+        aabb.min = aabb.max = vertices[0].Position;
+        for (const Vertex &vertex : vertices)
+            aabb.expand(vertex.Position);
+
+        sphere.center = aabb.center();
+        sphere.radius = 0.0f;
+        for (const Vertex &vertex : vertices)
+            sphere.radius = std::max(sphere.radius, glm::distance(sphere.center, vertex.Position));
     }
 };
 #endif
\ No newline at end of file
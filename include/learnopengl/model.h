@@ -12,6 +12,8 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/MeshSimplifier.h>
+#include <rg/MeshOptimizer.h>
 
 #include <string>
 #include <fstream>
@@ -23,6 +25,13 @@ using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// detail levels built per mesh at import, every level aims for half the triangles of the previous one
+const unsigned int MAX_LODS = 4;
+// fraction of the screen height below which the next coarser level is used
+const float LOD_SCREEN_SIZES[MAX_LODS - 1] = {0.25f, 0.12f, 0.05f};
+// how far past a threshold the size has to move before the level changes again
+const float LOD_HYSTERESIS = 0.2f;
+
 
 
 class Model
@@ -33,6 +42,12 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // object space bounds of all the meshes together
+    AABB aabb;
+    BoundingSphere sphere;
+    // currently selected detail level and what the last Draw call rendered
+    unsigned int lod = 0;
+    unsigned int trianglesDrawn = 0;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
@@ -47,12 +62,79 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws only the meshes whose bounding spheres touch the frustum and returns how many were drawn
+    unsigned int Draw(Shader &shader, const Frustum &frustum, const glm::mat4 &model)
+    {
+        cullBatch.clear();
+        for (const Mesh &mesh : meshes)
+            cullBatch.push_back(mesh.sphere.transformed(model));
+        frustum.cullSpheres(cullBatch, cullVisible);
+
+        unsigned int drawn = 0;
+        trianglesDrawn = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            if (cullVisible[i]) {
+                meshes[i].Draw(shader);
+                trianglesDrawn += meshes[i].TriangleCount();
+                drawn++;
+            }
+        }
+        return drawn;
+    }
+
+    // picks the detail level from the fraction of the screen height the model covers
+    void SelectLod(float screenSize)
+    {
+        while (lod < MAX_LODS - 1 && screenSize < LOD_SCREEN_SIZES[lod] * (1.0f - LOD_HYSTERESIS))
+            lod++;
+        while (lod > 0 && screenSize > LOD_SCREEN_SIZES[lod - 1] * (1.0f + LOD_HYSTERESIS))
+            lod--;
+
+        for (Mesh &mesh : meshes)
+            mesh.lod = std::min(lod, (unsigned int)mesh.lods.size() - 1);
+    }
+
+    // uploads every mesh with just the vertex streams the given programs read and
+    // keeps as much of the CPU side geometry as residency asks for
+    void Upload(std::initializer_list<const Shader *> programs, MeshResidency residency = DROP_AFTER_UPLOAD)
+    {
+        unsigned int attributeMask = 0;
+        for (const Shader *program : programs)
+            attributeMask |= ConsumedAttributes(program->ID);
+
+        for (Mesh &mesh : meshes)
+            mesh.Upload(attributeMask, residency);
+
+        // only needed to share textures between meshes while loading
+        vector<Texture>().swap(textures_loaded);
+    }
+
+    size_t CpuBytes() const
+    {
+        size_t bytes = meshes.capacity() * sizeof(Mesh) + textures_loaded.capacity() * sizeof(Texture);
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.CpuBytes();
+        return bytes;
+    }
+
+    size_t GpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.gpuBytes;
+        return bytes;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
 private:
+    // scratch space for the per-mesh culling, kept around so drawing does not allocate
+    SphereBatch cullBatch;
+    vector<uint8_t> cullVisible;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
@@ -70,6 +152,17 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        // merge the mesh bounds into the bounds of the whole model
+        if (!meshes.empty()) {
+            aabb = meshes[0].aabb;
+            for (const Mesh &mesh : meshes)
+                aabb.expand(mesh.aabb);
+            sphere.center = aabb.center();
+            sphere.radius = 0.0f;
+            for (const Mesh &mesh : meshes)
+                sphere.radius = std::max(sphere.radius, glm::distance(sphere.center, mesh.sphere.center) + mesh.sphere.radius);
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -102,6 +195,8 @@ private:
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
             Vertex vertex;
+            // whatever the file does not provide stays zero, so duplicates compare equal when welding
+            vertex.Normal = vertex.Tangent = vertex.Bitangent = glm::vec3(0.0f);
             glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -178,8 +273,64 @@ private:
 
 
 
+        // assimp gives every face its own corners, weld them before anything looks at the topology
+        size_t importedVertices = vertices.size();
+        MeshOptimizer::weld(vertices, indices);
+        float acmrBefore = MeshOptimizer::acmr(indices.data(), indices.size(), vertices.size());
+
+        vector<MeshLod> lods = buildLods(vertices, indices);
+        optimizeMesh(vertices, indices, lods);
+
+        cout << "MESH::OPTIMIZE:: " << mesh->mName.C_Str() << ": " << importedVertices << " -> " << vertices.size()
+             << " vertices, ACMR " << acmrBefore << " -> " << MeshOptimizer::acmr(indices.data(), lods[0].indexCount, vertices.size()) << endl;
+
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, lods);
+    }
+
+    // orders every detail level for the vertex cache and overdraw, then the vertices for fetch locality
+    static void optimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices, const vector<MeshLod> &lods)
+    {
+        vector<glm::vec3> positions(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+
+        for (const MeshLod &level : lods) {
+            unsigned int *levelIndices = indices.data() + level.indexOffset;
+            MeshOptimizer::optimizeVertexCache(levelIndices, level.indexCount, vertices.size());
+            MeshOptimizer::optimizeOverdraw(levelIndices, level.indexCount, positions);
+        }
+        MeshOptimizer::optimizeVertexFetch(vertices, indices);
+    }
+
+    // simplifies the mesh level by level and appends every level to indices
+    static vector<MeshLod> buildLods(const vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        vector<MeshLod> lods;
+        lods.push_back({0, (unsigned int)indices.size(), 0.0f});
+
+        vector<glm::vec3> positions(vertices.size());
+        vector<MeshSimplifier::Attributes> attributes(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++) {
+            positions[i] = vertices[i].Position;
+            attributes[i].normal = vertices[i].Normal;
+            attributes[i].texCoords = vertices[i].TexCoords;
+        }
+
+        vector<unsigned int> previous = indices;
+        while (lods.size() < MAX_LODS) {
+            float error = 0.0f;
+            vector<unsigned int> level = MeshSimplifier::simplify(positions, attributes, previous, previous.size() / 2, FLT_MAX, &error);
+
+            // not worth a level of its own if the simplifier got stuck
+            if (level.empty() || level.size() > previous.size() * 9 / 10)
+                break;
+
+            lods.push_back({(unsigned int)indices.size(), (unsigned int)level.size(), error});
+            indices.insert(indices.end(), level.begin(), level.end());
+            previous = level;
+        }
+        return lods;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
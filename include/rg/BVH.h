@@ -0,0 +1,376 @@
+#ifndef PROJECT_BASE_BVH_H
+#define PROJECT_BASE_BVH_H
+
+#include <rg/Frustum.h>
+#include <rg/Error.h>
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Dynamic bounding volume hierarchy over the bounds of renderable objects.
+// Leaves store a "fat" box enlarged by a margin, so an object moving a little every frame
+// (the orbiting planets) only gets reinserted once it leaves its fat box. The tree is kept
+// balanced with AVL style rotations, so frustum, sphere and nearest queries stay logarithmic.
+class DynamicBVH {
+public:
+    static const int Null = -1;
+
+    explicit DynamicBVH(float margin = 0.5f) : margin(margin) {}
+
+    // returns the proxy id of the new leaf, userData is what the queries report back
+    int createProxy(const AABB &box, int userData)
+    {
+        int proxy = allocateNode();
+        nodes[proxy].tight = box;
+        nodes[proxy].box = fatten(box);
+        nodes[proxy].userData = userData;
+        nodes[proxy].height = 0;
+        insertLeaf(proxy);
+        return proxy;
+    }
+
+    void destroyProxy(int proxy)
+    {
+        ASSERT(nodes[proxy].isLeaf(), "Only leaves can be destroyed");
+        removeLeaf(proxy);
+        freeNode(proxy);
+    }
+
+    // updates the bounds of a proxy, returns true when the leaf had to be reinserted
+    bool moveProxy(int proxy, const AABB &box)
+    {
+        ASSERT(nodes[proxy].isLeaf(), "Only leaves can be moved");
+        nodes[proxy].tight = box;
+        if (nodes[proxy].box.contains(box))
+            return false;
+
+        removeLeaf(proxy);
+        nodes[proxy].box = fatten(box);
+        insertLeaf(proxy);
+        return true;
+    }
+
+    int userData(int proxy) const { return nodes[proxy].userData; }
+    const AABB &bounds(int proxy) const { return nodes[proxy].tight; }
+    int height() const { return root == Null ? 0 : nodes[root].height; }
+
+    // userData of every proxy whose bounds touch the frustum
+    void queryFrustum(const Frustum &frustum, std::vector<int> &out) const
+    {
+        out.clear();
+        if (root == Null)
+            return;
+
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            const Node &node = nodes[index];
+
+            Frustum::Containment containment = frustum.classify(node.box);
+            if (containment == Frustum::OUTSIDE)
+                continue;
+
+            if (containment == Frustum::INSIDE) {
+                collectLeaves(index, out);
+            } else if (node.isLeaf()) {
+                if (frustum.intersects(node.tight))
+                    out.push_back(node.userData);
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    // userData of every proxy whose bounds are closer than radius to center, radius 0 is a point query
+    void querySphere(const glm::vec3 &center, float radius, std::vector<int> &out) const
+    {
+        out.clear();
+        if (root == Null)
+            return;
+
+        float radiusSquared = radius * radius;
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (node.box.distanceSquared(center) > radiusSquared)
+                continue;
+
+            if (node.isLeaf()) {
+                if (node.tight.distanceSquared(center) <= radiusSquared)
+                    out.push_back(node.userData);
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    // userData of the k proxies closest to point, nearest first
+    void queryNearest(const glm::vec3 &point, size_t k, std::vector<int> &out) const
+    {
+        out.clear();
+        if (root == Null || k == 0)
+            return;
+
+        // best first search: inner nodes are keyed by the distance to their fat box which never
+        // overestimates, leaves are pushed a second time with their exact distance
+        typedef std::pair<float, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+        open.push(Entry(nodes[root].box.distanceSquared(point), root));
+
+        while (!open.empty() && out.size() < k) {
+            Entry entry = open.top();
+            open.pop();
+
+            // a resolved leaf is encoded as -(index + 1)
+            if (entry.second < 0) {
+                out.push_back(nodes[-entry.second - 1].userData);
+                continue;
+            }
+
+            const Node &node = nodes[entry.second];
+            if (node.isLeaf()) {
+                open.push(Entry(node.tight.distanceSquared(point), -entry.second - 1));
+            } else {
+                open.push(Entry(nodes[node.child1].box.distanceSquared(point), node.child1));
+                open.push(Entry(nodes[node.child2].box.distanceSquared(point), node.child2));
+            }
+        }
+    }
+
+private:
+    struct Node {
+        AABB box;   // fat bounds, what the tree is built from
+        AABB tight; // exact bounds of a leaf
+        int parent = Null; // next free node while on the free list
+        int child1 = Null;
+        int child2 = Null;
+        int height = -1;   // leaf = 0, free node = -1
+        int userData = -1;
+
+        bool isLeaf() const { return child1 == Null; }
+    };
+
+    std::vector<Node> nodes;
+    int root = Null;
+    int freeList = Null;
+    float margin;
+    mutable std::vector<int> stack;
+
+    AABB fatten(const AABB &box) const
+    {
+        AABB result;
+        result.min = box.min - glm::vec3(margin);
+        result.max = box.max + glm::vec3(margin);
+        return result;
+    }
+
+    int allocateNode()
+    {
+        int index;
+        if (freeList != Null) {
+            index = freeList;
+            freeList = nodes[index].parent;
+        } else {
+            index = (int)nodes.size();
+            nodes.push_back(Node());
+        }
+        nodes[index] = Node();
+        nodes[index].height = 0;
+        return index;
+    }
+
+    void freeNode(int index)
+    {
+        nodes[index] = Node();
+        nodes[index].parent = freeList;
+        freeList = index;
+    }
+
+    void collectLeaves(int index, std::vector<int> &out) const
+    {
+        size_t base = stack.size();
+        stack.push_back(index);
+        while (stack.size() > base) {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.isLeaf()) {
+                out.push_back(node.userData);
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    void insertLeaf(int leaf)
+    {
+        if (root == Null) {
+            root = leaf;
+            nodes[root].parent = Null;
+            return;
+        }
+
+        // descend towards the sibling with the smallest surface area cost
+        AABB leafBox = nodes[leaf].box;
+        int index = root;
+        while (!nodes[index].isLeaf()) {
+            int child1 = nodes[index].child1;
+            int child2 = nodes[index].child2;
+
+            float area = nodes[index].box.surfaceArea();
+            float combinedArea = AABB::merge(nodes[index].box, leafBox).surfaceArea();
+
+            // cost of making a new parent for this node and the new leaf
+            float cost = 2.0f * combinedArea;
+            // minimum cost of pushing the leaf further down the tree
+            float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float cost1 = descendCost(child1, leafBox) + inheritanceCost;
+            float cost2 = descendCost(child2, leafBox) + inheritanceCost;
+
+            if (cost < cost1 && cost < cost2)
+                break;
+
+            index = cost1 < cost2 ? child1 : child2;
+        }
+
+        int sibling = index;
+        int oldParent = nodes[sibling].parent;
+        int newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = AABB::merge(leafBox, nodes[sibling].box);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        if (oldParent != Null) {
+            if (nodes[oldParent].child1 == sibling)
+                nodes[oldParent].child1 = newParent;
+            else
+                nodes[oldParent].child2 = newParent;
+        } else {
+            root = newParent;
+        }
+
+        refitFrom(nodes[leaf].parent);
+    }
+
+    float descendCost(int child, const AABB &leafBox) const
+    {
+        float merged = AABB::merge(leafBox, nodes[child].box).surfaceArea();
+        if (nodes[child].isLeaf())
+            return merged;
+        return merged - nodes[child].box.surfaceArea();
+    }
+
+    void removeLeaf(int leaf)
+    {
+        if (leaf == root) {
+            root = Null;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+        if (grandParent != Null) {
+            if (nodes[grandParent].child1 == parent)
+                nodes[grandParent].child1 = sibling;
+            else
+                nodes[grandParent].child2 = sibling;
+            nodes[sibling].parent = grandParent;
+            freeNode(parent);
+            refitFrom(grandParent);
+        } else {
+            root = sibling;
+            nodes[sibling].parent = Null;
+            freeNode(parent);
+        }
+        nodes[leaf].parent = Null;
+    }
+
+    // walks up to the root fixing boxes and heights, rotating where the tree got unbalanced
+    void refitFrom(int index)
+    {
+        while (index != Null) {
+            index = balance(index);
+
+            int child1 = nodes[index].child1;
+            int child2 = nodes[index].child2;
+            nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+            nodes[index].box = AABB::merge(nodes[child1].box, nodes[child2].box);
+
+            index = nodes[index].parent;
+        }
+    }
+
+    // rotates the taller grandchild up if the subtree at a is unbalanced, returns the new subtree root
+    int balance(int a)
+    {
+        if (nodes[a].isLeaf() || nodes[a].height < 2)
+            return a;
+
+        int b = nodes[a].child1;
+        int c = nodes[a].child2;
+        int difference = nodes[c].height - nodes[b].height;
+
+        if (difference > 1)
+            return rotateUp(a, c, b, false);
+        if (difference < -1)
+            return rotateUp(a, b, c, true);
+        return a;
+    }
+
+    // promotes child "up" of a into a's place, "other" is a's remaining child
+    int rotateUp(int a, int up, int other, bool upIsChild1)
+    {
+        int f = nodes[up].child1;
+        int g = nodes[up].child2;
+
+        nodes[up].child1 = a;
+        nodes[up].parent = nodes[a].parent;
+        nodes[a].parent = up;
+
+        if (nodes[up].parent != Null) {
+            int parent = nodes[up].parent;
+            if (nodes[parent].child1 == a)
+                nodes[parent].child1 = up;
+            else
+                nodes[parent].child2 = up;
+        } else {
+            root = up;
+        }
+
+        // the taller grandchild stays with up, the shorter one replaces up under a
+        int keep = nodes[f].height > nodes[g].height ? f : g;
+        int give = keep == f ? g : f;
+
+        nodes[up].child2 = keep;
+        if (upIsChild1)
+            nodes[a].child1 = give;
+        else
+            nodes[a].child2 = give;
+        nodes[give].parent = a;
+
+        nodes[a].box = AABB::merge(nodes[other].box, nodes[give].box);
+        nodes[a].height = 1 + std::max(nodes[other].height, nodes[give].height);
+        nodes[up].box = AABB::merge(nodes[a].box, nodes[keep].box);
+        nodes[up].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+
+        return up;
+    }
+};
+
+#endif //PROJECT_BASE_BVH_H
@@ -0,0 +1,340 @@
+#ifndef PROJECT_BASE_BLOOM_H
+#define PROJECT_BASE_BLOOM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/ComputeShader.h>
+#include <rg/GLCaps.h>
+#include <rg/RenderTargetPool.h>
+#include <algorithm>
+#include <vector>
+
+// Blurs the bright parts of the frame into a glow texture. All targets are transient and come
+// from the render target pool, so they follow the scene size and are shared between the modes.
+// The bright pass thresholds the scene luminance into a target at 1/resolutionDivisor of the
+// scene size, so the scene pass writes a single color attachment and every blur pass below runs
+// on the reduced image.
+// DUAL_FILTER halves the image down a mip chain with a 13 tap filter and walks back up with a
+// 3x3 tent filter, adding every level onto the next bigger one; each pass touches a quarter of the
+// pixels of the previous one, so a wide glow costs about as much as two full resolution passes.
+// GAUSSIAN is the separable 9 tap kernel at bright pass resolution. With compute shaders every
+// dispatch does a horizontal and a vertical pass out of shared memory, reading and writing the image
+// once; otherwise it ping-pongs fragment passes with the kernel folded into 5 bilinear fetches.
+// In temporal mode the bright pass and blur run every other frame only. Every frame reprojects the
+// last glow into the current camera from the scene depth and keeps it in a pair of history targets,
+// blending it with the fresh glow when there is one; pixels whose history was made for a surface
+// at another depth fall back to the fresh glow, or to the unmoved history on the frames between.
+// That reprojection and its two full size RGBA16F targets are paid every frame, so what the mode
+// saves depends on how much the skipped chain costs; the frame graph times it as "bloom (temporal)"
+// next to the plain "bloom" pass.
+class Bloom {
+public:
+    enum Mode { DUAL_FILTER, GAUSSIAN };
+    Mode mode = DUAL_FILTER;
+
+    // luminance above which the scene glows, and 2 or 4 for a half or quarter resolution bright pass
+    float threshold = 1.0f;
+    int resolutionDivisor = 2;
+
+    // chain depth and tent radius in texels of the level being upsampled
+    int mipCount = 5;
+    float radius = 1.0f;
+    // ping-pong passes of the gaussian mode, a compute dispatch counts as two
+    unsigned int gaussianPasses = 10;
+    // use the compute blur when the driver has it
+    bool computeBlur = true;
+    // bright pass and blur every other frame only, needs setView() every frame
+    bool temporal = false;
+    // share of the reprojected history kept on the frames that do run the chain
+    float historyWeight = 0.25f;
+
+    static const int MAX_MIPS = 8;
+
+    // drawQuad draws a full screen quad, blurCompute may be invalid and the fragment blur is used then
+    void init(RenderTargetPool *pool, Shader *brightPass, Shader *downsample, Shader *upsample, Shader *blur,
+              ComputeShader *blurCompute, Shader *temporalResolve, void (*drawQuad)())
+    {
+        this->pool = pool;
+        this->brightPass = brightPass;
+        this->downsample = downsample;
+        this->upsample = upsample;
+        this->blur = blur;
+        this->blurCompute = blurCompute;
+        this->temporalResolve = temporalResolve;
+        this->drawQuad = drawQuad;
+    }
+
+    ~Bloom()
+    {
+        releaseHistory();
+    }
+
+    // camera the next render() is for and the depth texture of its scene, for the temporal mode;
+    // depthScale is the part of the depth texture covered, which differs from the scene's when the
+    // bloom runs on an upsampled image
+    void setView(const glm::mat4 &viewProjection, unsigned int sceneDepth, glm::vec2 depthScale = glm::vec2(1.0f))
+    {
+        this->viewProjection = viewProjection;
+        this->sceneDepth = sceneDepth;
+        this->depthScale = depthScale;
+    }
+
+    // Extracts and blurs the bright parts of scene, of which only the lower left sceneScale part was
+    // rendered. Returns the target holding the glow over all of it, sampled with linear filtering;
+    // the caller releases it back to the pool once it has been composited, unless keepsResult().
+    // The chain is always sized after the full scene target, a different scale never reallocates anything.
+    RenderTarget *render(const RenderTarget &scene, glm::vec2 sceneScale = glm::vec2(1.0f))
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        RenderTarget *result;
+        if (temporal && sceneDepth) {
+            result = renderTemporal(scene, sceneScale);
+        } else {
+            releaseHistory();
+            result = renderChain(scene, sceneScale);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return result;
+    }
+
+    // the dual filter result is the sum of every level, this brings it back to the source brightness
+    float strength() const
+    {
+        return mode == DUAL_FILTER ? 1.0f / (float)std::max(1, levels) : 1.0f;
+    }
+
+    bool usesCompute() const
+    {
+        return computeBlur && blurCompute && blurCompute->valid();
+    }
+
+    // the last result is a temporal history target, it stays with the bloom across frames
+    bool keepsResult() const { return history[0] != nullptr; }
+
+    // whether the last render() ran the bright pass and blur
+    bool updatedChain() const { return chainUpdated; }
+
+    // gives the temporal history back to the pool, also for frames in which render() does not run
+    void releaseHistory()
+    {
+        if (!history[0])
+            return;
+        pool->release(history[0]);
+        pool->release(history[1]);
+        history[0] = history[1] = nullptr;
+    }
+
+private:
+    // local size of blur.cs
+    static const int COMPUTE_TILE = 16;
+
+    RenderTargetPool *pool = nullptr;
+    Shader *brightPass = nullptr;
+    Shader *downsample = nullptr;
+    Shader *upsample = nullptr;
+    Shader *blur = nullptr;
+    ComputeShader *blurCompute = nullptr;
+    Shader *temporalResolve = nullptr;
+    void (*drawQuad)() = nullptr;
+
+    // dual filter levels used last frame
+    int levels = 1;
+    bool chainUpdated = false;
+
+    // temporal mode: the history pair, the one written last and what it was made with
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    unsigned int sceneDepth = 0;
+    glm::vec2 depthScale = glm::vec2(1.0f);
+    RenderTarget *history[2] = {nullptr, nullptr};
+    int historyIndex = 0;
+    glm::mat4 historyViewProjection = glm::mat4(1.0f);
+    glm::ivec2 historySceneSize = glm::ivec2(0);
+    Mode historyMode = DUAL_FILTER;
+    int historyDivisor = 0;
+    bool skipNext = false;
+
+    RenderTarget *renderChain(const RenderTarget &scene, glm::vec2 sceneScale)
+    {
+        chainUpdated = true;
+        RenderTarget *bright = renderBrightPass(scene, sceneScale);
+        if (mode == DUAL_FILTER)
+            return renderDualFilter(bright);
+        else if (usesCompute())
+            return renderGaussianCompute(bright);
+        return renderGaussian(bright);
+    }
+
+    RenderTarget *renderTemporal(const RenderTarget &scene, glm::vec2 sceneScale)
+    {
+        // a history made from another size or filter starts over with a full update
+        bool reset = !history[0] || historySceneSize != glm::ivec2(scene.width, scene.height) ||
+                     historyMode != mode || historyDivisor != resolutionDivisor;
+        bool update = reset || !skipNext;
+        skipNext = update;
+
+        RenderTarget *current = nullptr;
+        if (update) {
+            current = renderChain(scene, sceneScale);
+            if (reset) {
+                releaseHistory();
+                // alpha keeps the view depth for the disocclusion test
+                history[0] = pool->acquire(GL_RGBA16F, current->width, current->height);
+                history[1] = pool->acquire(GL_RGBA16F, current->width, current->height);
+                historySceneSize = glm::ivec2(scene.width, scene.height);
+                historyMode = mode;
+                historyDivisor = resolutionDivisor;
+            }
+        } else {
+            chainUpdated = false;
+        }
+
+        RenderTarget *previous = history[historyIndex];
+        RenderTarget *next = history[1 - historyIndex];
+        glBindFramebuffer(GL_FRAMEBUFFER, next->fbo);
+        glViewport(0, 0, next->width, next->height);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, current ? current->texture : previous->texture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, previous->texture);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth);
+
+        temporalResolve->use();
+        temporalResolve->setInt("current", 0);
+        temporalResolve->setInt("history", 1);
+        temporalResolve->setInt("depth", 2);
+        temporalResolve->setBool("updated", update);
+        // right after a reset the history is garbage
+        temporalResolve->setFloat("historyWeight", reset ? 0.0f : historyWeight);
+        temporalResolve->setMat4("viewProjection", viewProjection);
+        temporalResolve->setMat4("inverseViewProjection", glm::inverse(viewProjection));
+        temporalResolve->setMat4("historyViewProjection", historyViewProjection);
+        temporalResolve->setVec2("depthScale", depthScale);
+        temporalResolve->setFloat("depthTolerance", 0.1f);
+        // alpha is the depth, not coverage
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        glDisable(GL_BLEND);
+        drawQuad();
+        if (blend)
+            glEnable(GL_BLEND);
+        glActiveTexture(GL_TEXTURE0);
+
+        pool->release(current);
+        historyIndex = 1 - historyIndex;
+        historyViewProjection = viewProjection;
+        return next;
+    }
+
+    RenderTarget *renderBrightPass(const RenderTarget &scene, glm::vec2 sceneScale)
+    {
+        int divisor = resolutionDivisor == 4 ? 4 : 2;
+        // the chain keeps the scene format, no pass needs alpha
+        RenderTarget *bright = pool->acquire(scene.format, std::max(1, scene.width / divisor), std::max(1, scene.height / divisor));
+
+        glBindFramebuffer(GL_FRAMEBUFFER, bright->fbo);
+        glViewport(0, 0, bright->width, bright->height);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, scene.texture);
+
+        brightPass->use();
+        brightPass->setInt("scene", 0);
+        brightPass->setFloat("threshold", threshold);
+        brightPass->setVec2("tapOffset", glm::vec2(divisor * 0.25f / scene.width, divisor * 0.25f / scene.height));
+        brightPass->setVec2("sceneScale", sceneScale);
+        drawQuad();
+        return bright;
+    }
+
+    RenderTarget *renderDualFilter(RenderTarget *bright)
+    {
+        glActiveTexture(GL_TEXTURE0);
+
+        // down: every level filters the one above it, the bright target is free again after the first
+        std::vector<RenderTarget *> mips;
+        downsample->use();
+        downsample->setInt("source", 0);
+        RenderTarget *input = bright;
+        for (int i = 0; i < std::max(1, std::min(mipCount, MAX_MIPS)); i++) {
+            RenderTarget *mip = pool->acquire(bright->format, std::max(1, input->width / 2), std::max(1, input->height / 2));
+            glBindFramebuffer(GL_FRAMEBUFFER, mip->fbo);
+            glViewport(0, 0, mip->width, mip->height);
+            glBindTexture(GL_TEXTURE_2D, input->texture);
+            drawQuad();
+            if (input == bright)
+                pool->release(bright);
+            mips.push_back(mip);
+            input = mip;
+
+            if (mip->width == 1 && mip->height == 1)
+                break;
+        }
+        levels = (int)mips.size();
+
+        // up: each level is tent filtered and added onto the next bigger one
+        upsample->use();
+        upsample->setInt("source", 0);
+        upsample->setFloat("radius", radius);
+        glBlendFunc(GL_ONE, GL_ONE);
+        for (size_t i = mips.size() - 1; i > 0; i--) {
+            RenderTarget *target = mips[i - 1];
+            glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+            glViewport(0, 0, target->width, target->height);
+            glBindTexture(GL_TEXTURE_2D, mips[i]->texture);
+            drawQuad();
+            pool->release(mips[i]);
+        }
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        return mips[0];
+    }
+
+    // the bright target is one half of the ping-pong pair
+    RenderTarget *renderGaussian(RenderTarget *bright)
+    {
+        RenderTarget *pingpong[2] = {bright, pool->acquire(bright->format, bright->width, bright->height)};
+        bool horizontal = true;
+        glViewport(0, 0, bright->width, bright->height);
+        glActiveTexture(GL_TEXTURE0);
+        blur->use();
+
+        for (unsigned int i = 0; i < gaussianPasses; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, pingpong[horizontal]->fbo);
+            blur->setVec2("direction", horizontal ? glm::vec2(1.0f / bright->width, 0.0f) : glm::vec2(0.0f, 1.0f / bright->height));
+            glBindTexture(GL_TEXTURE_2D, pingpong[!horizontal]->texture);  // bind texture of the other framebuffer
+            drawQuad();
+            horizontal = !horizontal;
+        }
+        pool->release(pingpong[horizontal]);
+        return pingpong[!horizontal];
+    }
+
+    RenderTarget *renderGaussianCompute(RenderTarget *bright)
+    {
+        const GLCaps &caps = GLCaps::get();
+        RenderTarget *pingpong[2] = {pool->acquire(bright->format, bright->width, bright->height), bright};
+        glActiveTexture(GL_TEXTURE0);
+        blurCompute->use();
+
+        RenderTarget *input = bright, *output = bright;
+        unsigned int dispatches = std::max(1u, (gaussianPasses + 1) / 2);
+        for (unsigned int i = 0; i < dispatches; i++) {
+            output = pingpong[i % 2];
+            glBindTexture(GL_TEXTURE_2D, input->texture);
+            caps.bindImageTexture(0, output->texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, output->format);
+            blurCompute->dispatch((output->width + COMPUTE_TILE - 1) / COMPUTE_TILE, (output->height + COMPUTE_TILE - 1) / COMPUTE_TILE);
+            // the next dispatch and the composite sample what this one wrote
+            caps.memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+            input = output;
+        }
+        pool->release(output == pingpong[0] ? pingpong[1] : pingpong[0]);
+        return output;
+    }
+};
+
+#endif //PROJECT_BASE_BLOOM_H
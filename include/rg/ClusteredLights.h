@@ -0,0 +1,218 @@
+#ifndef PROJECT_BASE_CLUSTEREDLIGHTS_H
+#define PROJECT_BASE_CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Clustered forward lighting. The view frustum is cut into GRID_X x GRID_Y screen tiles and GRID_Z
+// slices that get exponentially deeper, and every frame the CPU puts each point light into the
+// clusters its range touches. The shaders find their cluster from gl_FragCoord and the fragment
+// depth and only loop over the lights listed there, so the cost of a fragment follows the lights
+// that actually reach it instead of all of them.
+// Everything reaches the shaders through texture buffers, GL 3.3 has no storage buffers:
+//  - lightData, RGBA32F, the packed lights of LightSystem as they are, four texels per light:
+//    position and range, ambient and constant, diffuse and linear, specular and quadratic,
+//  - lightGrid, RG32UI, first index and light count per cluster,
+//  - lightIndices, R32UI, the light lists of all clusters one after the other.
+// A texture buffer only has to hold GL_MAX_TEXTURE_BUFFER_SIZE texels, 65536 at least. Lights past
+// that many texels of lightData are left out, and once the index list is full the clusters after it
+// get only the lights that still fit; lights are listed by index, so the scene lights go in first.
+class ClusteredLights {
+public:
+    static const int GRID_X = 16;
+    static const int GRID_Y = 9;
+    static const int GRID_Z = 24;
+    static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+    void init()
+    {
+        GLint maxTexels = 65536;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxBufferTexels = maxTexels > 0 ? (size_t)maxTexels : 65536;
+        glGenBuffers(BUFFER_COUNT, buffers);
+        glGenTextures(BUFFER_COUNT, textures);
+        const GLenum formats[BUFFER_COUNT] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for (int i = 0; i < BUFFER_COUNT; i++) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    ~ClusteredLights()
+    {
+        if (buffers[0]) {
+            glDeleteTextures(BUFFER_COUNT, textures);
+            glDeleteBuffers(BUFFER_COUNT, buffers);
+        }
+    }
+
+    // assigns the packed lights to the clusters of this camera and uploads them, once per frame
+    void update(const std::vector<glm::vec4> &lightData, const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane)
+    {
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        size_t lightCount = std::min(lightData.size() / 4, maxBufferTexels / 4);
+
+        // count the lights per cluster, turn the counts into offsets, then fill the lists
+        clusterLow.resize(lightCount);
+        clusterHigh.resize(lightCount);
+        std::fill(grid.begin(), grid.end(), glm::uvec2(0));
+        for (size_t i = 0; i < lightCount; i++) {
+            glm::vec4 positionRange = lightData[i * 4];
+            if (!clusterRange(glm::vec3(view * glm::vec4(glm::vec3(positionRange), 1.0f)), positionRange.w, projection, clusterLow[i], clusterHigh[i]))
+                continue;
+            forEachCluster(clusterLow[i], clusterHigh[i], [&](int cluster) { grid[cluster].y++; });
+        }
+        litClusters = 0;
+        maxLights = 0;
+        for (const glm::uvec2 &cluster : grid) {
+            litClusters += cluster.y > 0 ? 1 : 0;
+            maxLights = std::max<size_t>(maxLights, cluster.y);
+        }
+        size_t requested = 0;
+        unsigned int offset = 0;
+        for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+            requested += grid[cluster].y;
+            grid[cluster].x = offset;
+            capacity[cluster] = std::min(grid[cluster].y, (unsigned int)(maxBufferTexels - offset));
+            offset += capacity[cluster];
+            grid[cluster].y = 0;
+        }
+        indices.resize(std::max(1u, offset));
+        for (size_t i = 0; i < lightCount; i++) {
+            if (clusterLow[i].x > clusterHigh[i].x)
+                continue;
+            forEachCluster(clusterLow[i], clusterHigh[i], [&](int cluster) {
+                if (grid[cluster].y < capacity[cluster])
+                    indices[grid[cluster].x + grid[cluster].y++] = (unsigned int)i;
+            });
+        }
+        listed = offset;
+        count = lightCount;
+        dropped = (lightData.size() / 4 - lightCount) + (requested - offset);
+
+        // orphaned every frame, the driver keeps the copy the last frame still reads
+        upload(LIGHT_DATA, lightData.data(), std::max<size_t>(1, lightCount * 4) * sizeof(glm::vec4));
+        upload(LIGHT_GRID, grid.data(), grid.size() * sizeof(glm::uvec2));
+        upload(LIGHT_INDICES, indices.data(), indices.size() * sizeof(unsigned int));
+    }
+
+    // binds the buffers to firstUnit and the two units after it and sets the lookup uniforms of shader,
+    // viewportSize is the size of the viewport the shader draws into
+    void bind(Shader &shader, glm::ivec2 viewportSize, int firstUnit) const
+    {
+        shader.use();
+        const char *names[BUFFER_COUNT] = {"lightData", "lightGrid", "lightIndices"};
+        for (int i = 0; i < BUFFER_COUNT; i++) {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            shader.setInt(names[i], firstUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setVec2("clusterScale", glm::vec2(GRID_X, GRID_Y) / glm::vec2(viewportSize));
+        shader.setVec2("depthRange", glm::vec2(nearPlane, farPlane));
+        shader.setFloat("sliceScale", GRID_Z / std::log(farPlane / nearPlane));
+    }
+
+    size_t lightCount() const { return count; }
+    // light references in all clusters together, what the shaders loop over at most per cluster
+    size_t listedCount() const { return listed; }
+    // what a fragment in a cluster with lights loops over, on average and at worst
+    float averageClusterLights() const { return litClusters ? (float)listed / (float)litClusters : 0.0f; }
+    size_t maxClusterLights() const { return maxLights; }
+    // lights and cluster entries left out because the buffers were full
+    size_t droppedCount() const { return dropped; }
+
+private:
+    enum { LIGHT_DATA, LIGHT_GRID, LIGHT_INDICES, BUFFER_COUNT };
+
+    unsigned int buffers[BUFFER_COUNT] = {};
+    unsigned int textures[BUFFER_COUNT] = {};
+    float nearPlane = 0.1f, farPlane = 100.0f;
+
+    // cluster range of each light, the storage is reused every frame
+    std::vector<glm::ivec3> clusterLow, clusterHigh;
+    std::vector<glm::uvec2> grid = std::vector<glm::uvec2>(CLUSTER_COUNT);
+    // index list entries each cluster got after the cap
+    std::vector<unsigned int> capacity = std::vector<unsigned int>(CLUSTER_COUNT);
+    size_t maxBufferTexels = 65536;
+    std::vector<unsigned int> indices;
+    size_t count = 0;
+    size_t listed = 0;
+    size_t litClusters = 0;
+    size_t maxLights = 0;
+    size_t dropped = 0;
+
+    void upload(int buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // slice of a view depth, the same as the shaders compute it
+    int slice(float depth) const
+    {
+        if (depth <= nearPlane)
+            return 0;
+        return std::min(GRID_Z - 1, (int)(std::log(depth / nearPlane) * GRID_Z / std::log(farPlane / nearPlane)));
+    }
+
+    // clusters touched by the view space bounding box of the light sphere, false when there are none
+    bool clusterRange(glm::vec3 center, float radius, const glm::mat4 &projection, glm::ivec3 &low, glm::ivec3 &high) const
+    {
+        low = glm::ivec3(1);
+        high = glm::ivec3(0);
+        float nearest = -center.z - radius;
+        float farthest = -center.z + radius;
+        if (radius <= 0.0f || farthest < nearPlane || nearest > farPlane)
+            return false;
+
+        glm::vec2 ndcLow(-1.0f), ndcHigh(1.0f);
+        if (nearest > nearPlane) {
+            // corners of the box, each side is widest at the depth nearest to the camera on its side
+            ndcLow = glm::vec2(1.0f);
+            ndcHigh = glm::vec2(-1.0f);
+            for (float depth : {nearest, farthest}) {
+                for (float sx : {-1.0f, 1.0f}) {
+                    for (float sy : {-1.0f, 1.0f}) {
+                        glm::vec2 ndc = glm::vec2(projection[0][0] * (center.x + sx * radius), projection[1][1] * (center.y + sy * radius)) / depth;
+                        ndcLow = glm::min(ndcLow, ndc);
+                        ndcHigh = glm::max(ndcHigh, ndc);
+                    }
+                }
+            }
+            if (ndcLow.x > 1.0f || ndcLow.y > 1.0f || ndcHigh.x < -1.0f || ndcHigh.y < -1.0f)
+                return false;
+        }
+
+        glm::vec2 tiles(GRID_X, GRID_Y);
+        glm::ivec2 tileLow = glm::clamp(glm::ivec2(glm::floor((ndcLow * 0.5f + 0.5f) * tiles)), glm::ivec2(0), glm::ivec2(GRID_X - 1, GRID_Y - 1));
+        glm::ivec2 tileHigh = glm::clamp(glm::ivec2(glm::floor((ndcHigh * 0.5f + 0.5f) * tiles)), glm::ivec2(0), glm::ivec2(GRID_X - 1, GRID_Y - 1));
+        low = glm::ivec3(tileLow, slice(nearest));
+        high = glm::ivec3(tileHigh, slice(farthest));
+        return true;
+    }
+
+    template <typename F>
+    static void forEachCluster(glm::ivec3 low, glm::ivec3 high, F f)
+    {
+        for (int z = low.z; z <= high.z; z++) {
+            for (int y = low.y; y <= high.y; y++) {
+                for (int x = low.x; x <= high.x; x++)
+                    f((z * GRID_Y + y) * GRID_X + x);
+            }
+        }
+    }
+};
+
+#endif //PROJECT_BASE_CLUSTEREDLIGHTS_H
@@ -0,0 +1,96 @@
+#ifndef PROJECT_BASE_COMPUTESHADER_H
+#define PROJECT_BASE_COMPUTESHADER_H
+
+#include <glad/glad.h>
+#include <rg/GLCaps.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Compute program, the counterpart of learnopengl's Shader. On a driver without compute shaders
+// nothing is compiled and valid() is false, so it can be declared next to the other programs.
+class ComputeShader {
+public:
+    unsigned int ID = 0;
+
+    explicit ComputeShader(const char *computePath)
+    {
+        if (!GLCaps::get().computeShaders())
+            return;
+
+        std::string code;
+        std::ifstream file(computePath);
+        if (!file) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << computePath << std::endl;
+            return;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        code = stream.str();
+        const char *source = code.c_str();
+
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &source, NULL);
+        glCompileShader(compute);
+        bool compiled = checkCompileErrors(compute, "COMPUTE");
+
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        bool linked = checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+
+        if (!compiled || !linked) {
+            glDeleteProgram(ID);
+            ID = 0;
+        }
+    }
+
+    ~ComputeShader()
+    {
+        if (ID)
+            glDeleteProgram(ID);
+    }
+
+    bool valid() const { return ID != 0; }
+
+    void use() const
+    {
+        glUseProgram(ID);
+    }
+
+    // groups of the local size declared in the shader
+    void dispatch(unsigned int x, unsigned int y, unsigned int z = 1) const
+    {
+        GLCaps::get().dispatchCompute(x, y, z);
+    }
+
+    void setInt(const std::string &name, int value) const
+    {
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    }
+
+private:
+    static bool checkCompileErrors(GLuint object, const std::string &type)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if (type != "PROGRAM") {
+            glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                glGetShaderInfoLog(object, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << std::endl;
+            }
+        } else {
+            glGetProgramiv(object, GL_LINK_STATUS, &success);
+            if (!success) {
+                glGetProgramInfoLog(object, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
+            }
+        }
+        return success != 0;
+    }
+};
+
+#endif //PROJECT_BASE_COMPUTESHADER_H
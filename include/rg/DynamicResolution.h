@@ -0,0 +1,87 @@
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Picks the fraction of the framebuffer the scene is rendered at from the measured GPU frame time.
+// Every frame is wrapped in a GL_TIME_ELAPSED query; results are read LATENCY frames later, and only
+// once the query says they are available, so the CPU never waits for them. The scale follows the square root of target / measured time (the cost
+// is roughly proportional to the pixel count), damped and only outside a band below the target so
+// it settles instead of oscillating. Targets keep their full size, only the viewport shrinks.
+class DynamicResolution {
+public:
+    static const unsigned int LATENCY = 4;
+
+    bool enabled = true;
+    float targetMs = 1000.0f / 60.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+
+    void init()
+    {
+        glGenQueries(LATENCY, queries);
+    }
+
+    ~DynamicResolution()
+    {
+        if (queries[0])
+            glDeleteQueries(LATENCY, queries);
+    }
+
+    void beginFrame()
+    {
+        // the oldest query is reused now; a result that is still not there is dropped and the scale stays
+        if (pending[current]) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsed);
+                update((float)(elapsed / 1.0e6));
+            }
+            pending[current] = false;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void endFrame()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[current] = true;
+        current = (current + 1) % LATENCY;
+    }
+
+    float scale() const { return enabled ? currentScale : 1.0f; }
+    float gpuMs() const { return smoothedMs; }
+
+    // the part of a width x height target the scene covers this frame
+    glm::ivec2 viewport(int width, int height) const
+    {
+        return glm::ivec2(std::max(1, (int)std::lround(width * scale())), std::max(1, (int)std::lround(height * scale())));
+    }
+
+private:
+    unsigned int queries[LATENCY] = {};
+    bool pending[LATENCY] = {};
+    unsigned int current = 0;
+
+    float currentScale = 1.0f;
+    float smoothedMs = 0.0f;
+
+    void update(float frameMs)
+    {
+        smoothedMs = smoothedMs == 0.0f ? frameMs : glm::mix(smoothedMs, frameMs, 0.1f);
+        if (!enabled || smoothedMs <= 0.0f)
+            return;
+
+        if (smoothedMs > targetMs || smoothedMs < targetMs * 0.85f) {
+            float desired = currentScale * std::sqrt(targetMs / smoothedMs);
+            currentScale = glm::clamp(glm::mix(currentScale, desired, 0.25f), minScale, maxScale);
+        }
+    }
+};
+
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
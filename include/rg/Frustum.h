@@ -0,0 +1,248 @@
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RG_FRUSTUM_SSE 1
+#endif
+
+struct AABB {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+    void expand(const glm::vec3 &p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void expand(const AABB &other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    bool contains(const AABB &other) const
+    {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+            && other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+    }
+
+    bool contains(const glm::vec3 &p) const
+    {
+        return min.x <= p.x && min.y <= p.y && min.z <= p.z
+            && p.x <= max.x && p.y <= max.y && p.z <= max.z;
+    }
+
+    float surfaceArea() const
+    {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // squared distance from p to the closest point of the box, zero when p is inside
+    float distanceSquared(const glm::vec3 &p) const
+    {
+        glm::vec3 d = glm::max(glm::max(min - p, p - max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+    static AABB merge(const AABB &a, const AABB &b)
+    {
+        AABB result = a;
+        result.expand(b);
+        return result;
+    }
+
+    // world space box of the transformed box (Arvo's method, keeps it tight under rotation)
+    AABB transformed(const glm::mat4 &m) const
+    {
+        glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+        glm::vec3 e = extents();
+        glm::vec3 r;
+        for (int i = 0; i < 3; i++)
+            r[i] = std::abs(m[0][i]) * e.x + std::abs(m[1][i]) * e.y + std::abs(m[2][i]) * e.z;
+        AABB result;
+        result.min = c - r;
+        result.max = c + r;
+        return result;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    BoundingSphere transformed(const glm::mat4 &m) const
+    {
+        float sx = glm::length(glm::vec3(m[0]));
+        float sy = glm::length(glm::vec3(m[1]));
+        float sz = glm::length(glm::vec3(m[2]));
+
+        BoundingSphere result;
+        result.center = glm::vec3(m * glm::vec4(center, 1.0f));
+        result.radius = radius * std::max(sx, std::max(sy, sz));
+        return result;
+    }
+};
+
+// spheres stored as structure-of-arrays so the frustum test can load four of them into one register
+struct SphereBatch {
+    std::vector<float> x, y, z, r;
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        r.clear();
+    }
+
+    void push_back(const BoundingSphere &s)
+    {
+        x.push_back(s.center.x);
+        y.push_back(s.center.y);
+        z.push_back(s.center.z);
+        r.push_back(s.radius);
+    }
+
+    size_t size() const { return x.size(); }
+};
+
+class Frustum {
+public:
+    // left, right, bottom, top, near, far; xyz is the inward normal, w the distance
+    glm::vec4 planes[6];
+
+    Frustum()
+    {
+        for (glm::vec4 &plane : planes)
+            plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    // extracts the planes straight from projection * view (Gribb & Hartmann)
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool intersects(const BoundingSphere &sphere) const
+    {
+        for (const glm::vec4 &plane : planes) {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+                return false;
+        }
+        return true;
+    }
+
+    bool intersects(const AABB &box) const
+    {
+        for (const glm::vec4 &plane : planes) {
+            // the corner furthest along the plane normal
+            glm::vec3 p(plane.x >= 0.0f ? box.max.x : box.min.x,
+                        plane.y >= 0.0f ? box.max.y : box.min.y,
+                        plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    enum Containment { OUTSIDE, INTERSECTS, INSIDE };
+
+    // like intersects(), but also tells when the box is completely inside so hierarchies can stop testing
+    Containment classify(const AABB &box) const
+    {
+        Containment result = INSIDE;
+        for (const glm::vec4 &plane : planes) {
+            glm::vec3 n(plane);
+            glm::vec3 p(plane.x >= 0.0f ? box.max.x : box.min.x,
+                        plane.y >= 0.0f ? box.max.y : box.min.y,
+                        plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(n, p) + plane.w < 0.0f)
+                return OUTSIDE;
+
+            glm::vec3 q(plane.x >= 0.0f ? box.min.x : box.max.x,
+                        plane.y >= 0.0f ? box.min.y : box.max.y,
+                        plane.z >= 0.0f ? box.min.z : box.max.z);
+            if (glm::dot(n, q) + plane.w < 0.0f)
+                result = INTERSECTS;
+        }
+        return result;
+    }
+
+    // writes 1 into visible[i] for every sphere touching the frustum, returns the number of visible spheres
+    size_t cullSpheres(const SphereBatch &batch, std::vector<uint8_t> &visible) const
+    {
+        size_t count = batch.size();
+        visible.resize(count);
+        size_t i = 0;
+        size_t visibleCount = 0;
+
+#ifdef RG_FRUSTUM_SSE
+        __m128 px[6], py[6], pz[6], pw[6];
+        for (int p = 0; p < 6; p++) {
+            px[p] = _mm_set1_ps(planes[p].x);
+            py[p] = _mm_set1_ps(planes[p].y);
+            pz[p] = _mm_set1_ps(planes[p].z);
+            pw[p] = _mm_set1_ps(planes[p].w);
+        }
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(&batch.x[i]);
+            __m128 y = _mm_loadu_ps(&batch.y[i]);
+            __m128 z = _mm_loadu_ps(&batch.z[i]);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&batch.r[i]));
+
+            // a lane survives as long as it is not fully behind any of the planes
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++) {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, px[p]), _mm_mul_ps(y, py[p])),
+                                      _mm_add_ps(_mm_mul_ps(z, pz[p]), pw[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; lane < 4; lane++) {
+                visible[i + lane] = (mask >> lane) & 1;
+                visibleCount += visible[i + lane];
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            BoundingSphere sphere;
+            sphere.center = glm::vec3(batch.x[i], batch.y[i], batch.z[i]);
+            sphere.radius = batch.r[i];
+            visible[i] = intersects(sphere) ? 1 : 0;
+            visibleCount += visible[i];
+        }
+
+        return visibleCount;
+    }
+};
+
+#endif //PROJECT_BASE_FRUSTUM_H
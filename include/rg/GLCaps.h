@@ -0,0 +1,97 @@
+#ifndef PROJECT_BASE_GLCAPS_H
+#define PROJECT_BASE_GLCAPS_H
+
+#include <glad/glad.h>
+#include <string>
+#include <unordered_set>
+
+// enums newer than the 3.3 core profile glad was generated for
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+
+typedef void (APIENTRYP PFN_glBufferStorage)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP PFN_glDispatchCompute)(GLuint x, GLuint y, GLuint z);
+typedef void (APIENTRYP PFN_glBindImageTexture)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFN_glMemoryBarrier)(GLbitfield barriers);
+
+// What the driver offers beyond 3.3 core. The context is still created as 3.3, but most drivers
+// hand out their newest core version anyway, so newer features are picked up at runtime
+// and everything keeps a 3.3 fallback.
+struct GLCaps {
+    int major = 3;
+    int minor = 3;
+    std::unordered_set<std::string> extensions;
+
+    // occlusion queries that may report false positives but never false negatives, cheaper on tilers
+    bool conservativeOcclusion = false;
+
+    // immutable storage (GL 4.4 / ARB_buffer_storage), null when missing
+    PFN_glBufferStorage bufferStorage = nullptr;
+
+    // compute shaders with image load/store (GL 4.3), all three set or all null
+    PFN_glDispatchCompute dispatchCompute = nullptr;
+    PFN_glBindImageTexture bindImageTexture = nullptr;
+    PFN_glMemoryBarrier memoryBarrier = nullptr;
+
+    // call once after gladLoadGLLoader, with the same loader
+    void load(GLADloadproc loader)
+    {
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            extensions.insert((const char *)glGetStringi(GL_EXTENSIONS, i));
+
+        conservativeOcclusion = atLeast(4, 3) || hasExtension("GL_ARB_ES3_compatibility");
+
+        if (atLeast(4, 4) || hasExtension("GL_ARB_buffer_storage"))
+            bufferStorage = (PFN_glBufferStorage)loader("glBufferStorage");
+
+        if (atLeast(4, 3)) {
+            dispatchCompute = (PFN_glDispatchCompute)loader("glDispatchCompute");
+            bindImageTexture = (PFN_glBindImageTexture)loader("glBindImageTexture");
+            memoryBarrier = (PFN_glMemoryBarrier)loader("glMemoryBarrier");
+            if (!dispatchCompute || !bindImageTexture || !memoryBarrier) {
+                dispatchCompute = nullptr;
+                bindImageTexture = nullptr;
+                memoryBarrier = nullptr;
+            }
+        }
+    }
+
+    bool computeShaders() const
+    {
+        return dispatchCompute != nullptr;
+    }
+
+    bool atLeast(int requiredMajor, int requiredMinor) const
+    {
+        return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+    }
+
+    bool hasExtension(const char *name) const
+    {
+        return extensions.count(name) != 0;
+    }
+
+    static GLCaps &get()
+    {
+        static GLCaps caps;
+        return caps;
+    }
+};
+
+#endif //PROJECT_BASE_GLCAPS_H
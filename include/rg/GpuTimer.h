@@ -0,0 +1,118 @@
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/Error.h>
+#include <string>
+#include <vector>
+
+// Per pass GPU times from GL_TIMESTAMP queries. mark() starts a section that runs until the next
+// mark or endFrame(); timestamps do not nest like GL_TIME_ELAPSED, so this works next to the
+// frame query of DynamicResolution. Results are read LATENCY frames later and smoothed; a frame whose
+// timestamps are still not available then is skipped rather than waited for.
+class GpuTimer {
+public:
+    static const unsigned int LATENCY = 4;
+    static const unsigned int MAX_MARKS = 16;
+
+    struct Section {
+        std::string name;
+        float ms;
+    };
+
+    void init()
+    {
+        for (Frame &frame : frames)
+            glGenQueries(MAX_MARKS, frame.queries);
+    }
+
+    ~GpuTimer()
+    {
+        for (Frame &frame : frames) {
+            if (frame.queries[0])
+                glDeleteQueries(MAX_MARKS, frame.queries);
+        }
+    }
+
+    void beginFrame()
+    {
+        Frame &frame = frames[current];
+        if (frame.pending)
+            collect(frame);
+        frame.count = 0;
+    }
+
+    // name has to outlive the frame, a string literal
+    void mark(const char *name)
+    {
+        Frame &frame = frames[current];
+        ASSERT(frame.count < MAX_MARKS, "Too many GPU timer marks in one frame");
+        glQueryCounter(frame.queries[frame.count], GL_TIMESTAMP);
+        frame.names[frame.count++] = name;
+    }
+
+    void endFrame()
+    {
+        mark(nullptr);
+        frames[current].pending = true;
+        current = (current + 1) % LATENCY;
+    }
+
+    // smoothed time of a section, 0 when the last collected frame did not have it
+    float milliseconds(const std::string &name) const
+    {
+        for (const Section &section : sections) {
+            if (section.name == name)
+                return section.ms;
+        }
+        return 0.0f;
+    }
+
+    // sections of the last collected frame, in the order they ran
+    const std::vector<Section> &results() const { return sections; }
+
+private:
+    struct Frame {
+        unsigned int queries[MAX_MARKS] = {};
+        const char *names[MAX_MARKS] = {};
+        unsigned int count = 0;
+        bool pending = false;
+    };
+
+    Frame frames[LATENCY];
+    unsigned int current = 0;
+    std::vector<Section> sections;
+
+    void collect(Frame &frame)
+    {
+        frame.pending = false;
+
+        // timestamps complete in order, the last one being there means all of them are
+        GLuint available = 0;
+        if (frame.count > 0)
+            glGetQueryObjectuiv(frame.queries[frame.count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+
+        // sections that did not run are dropped, the ones that did keep their history
+        std::vector<Section> collected;
+        GLuint64 previous = 0;
+        for (unsigned int i = 0; i < frame.count; i++) {
+            GLuint64 timestamp = 0;
+            glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamp);
+            if (i > 0) {
+                float ms = (float)((timestamp - previous) / 1.0e6);
+                for (const Section &section : sections) {
+                    if (section.name == frame.names[i - 1])
+                        ms = glm::mix(section.ms, ms, 0.1f);
+                }
+                collected.push_back({frame.names[i - 1], ms});
+            }
+            previous = timestamp;
+        }
+        sections.swap(collected);
+    }
+};
+
+#endif //PROJECT_BASE_GPUTIMER_H
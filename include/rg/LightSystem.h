@@ -0,0 +1,104 @@
+#ifndef PROJECT_BASE_LIGHTSYSTEM_H
+#define PROJECT_BASE_LIGHTSYSTEM_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The point lights of the scene as a structure of arrays. Every light moves on an ellipse,
+// center + cos(time) * cosAxis + sin(time) * sinAxis, a fixed one has both axes 0. update() animates
+// all of them once per frame from the frame time and packs them into one array, four vec4 per light:
+// position and range, ambient and constant, diffuse and linear, specular and quadratic. That array is
+// what ClusteredLights uploads, so every shader sees the same lights and nothing evaluates them per draw.
+// The range in the packed array is where the shaders fade a light out and the clusters cull it; a light
+// added without a radius reaches as far as its attenuation stays above 1/256.
+class LightSystem {
+public:
+    // returns the index of the light, radius 0 takes the range from the attenuation
+    size_t add(glm::vec3 center, glm::vec3 cosAxis, glm::vec3 sinAxis, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
+               float constant, float linear, float quadratic, float radius = 0.0f)
+    {
+        centers.push_back(center);
+        cosAxes.push_back(cosAxis);
+        sinAxes.push_back(sinAxis);
+        ambients.push_back(ambient);
+        diffuses.push_back(diffuse);
+        speculars.push_back(specular);
+        constants.push_back(constant);
+        linears.push_back(linear);
+        quadratics.push_back(quadratic);
+        radii.push_back(radius);
+        return centers.size() - 1;
+    }
+
+    // keeps the first count lights
+    void resize(size_t count)
+    {
+        count = std::min(count, size());
+        for (std::vector<glm::vec3> *array : {&centers, &cosAxes, &sinAxes, &ambients, &diffuses, &speculars})
+            array->resize(count);
+        for (std::vector<float> *array : {&constants, &linears, &quadratics, &radii})
+            array->resize(count);
+    }
+
+    // colors of count lights from first on, for lights switched together
+    void setColors(size_t first, size_t count, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular)
+    {
+        size_t last = std::min(first + count, size());
+        std::fill(ambients.begin() + first, ambients.begin() + last, ambient);
+        std::fill(diffuses.begin() + first, diffuses.begin() + last, diffuse);
+        std::fill(speculars.begin() + first, speculars.begin() + last, specular);
+    }
+
+    // once per frame, before anything reads the lights
+    void update(float time)
+    {
+        size_t count = size();
+        float c = std::cos(time);
+        float s = std::sin(time);
+        positions.resize(count);
+        for (size_t i = 0; i < count; i++)
+            positions[i] = centers[i] + c * cosAxes[i] + s * sinAxes[i];
+
+        packed.resize(count * 4);
+        for (size_t i = 0; i < count; i++) {
+            packed[i * 4] = glm::vec4(positions[i], range(i));
+            packed[i * 4 + 1] = glm::vec4(ambients[i], constants[i]);
+            packed[i * 4 + 2] = glm::vec4(diffuses[i], linears[i]);
+            packed[i * 4 + 3] = glm::vec4(speculars[i], quadratics[i]);
+        }
+    }
+
+    size_t size() const { return centers.size(); }
+    // positions of the last update
+    const std::vector<glm::vec3> &currentPositions() const { return positions; }
+    // the upload layout of the last update, see above
+    const std::vector<glm::vec4> &packedLights() const { return packed; }
+
+private:
+    std::vector<glm::vec3> centers, cosAxes, sinAxes;
+    std::vector<glm::vec3> ambients, diffuses, speculars;
+    std::vector<float> constants, linears, quadratics, radii;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec4> packed;
+
+    // the radius, or the distance at which the brightest term of the light falls below 1/256
+    float range(size_t i) const
+    {
+        if (radii[i] > 0.0f)
+            return radii[i];
+        glm::vec3 brightest = glm::max(ambients[i], glm::max(diffuses[i], speculars[i]));
+        float intensity = std::max(brightest.x, std::max(brightest.y, brightest.z));
+        float cutoff = 256.0f * intensity;
+        if (cutoff <= constants[i])
+            return 0.0f;
+        if (quadratics[i] <= 0.0f)
+            return linears[i] > 0.0f ? (cutoff - constants[i]) / linears[i] : 1000.0f;
+        return (-linears[i] + std::sqrt(linears[i] * linears[i] - 4.0f * quadratics[i] * (constants[i] - cutoff))) /
+               (2.0f * quadratics[i]);
+    }
+};
+
+#endif //PROJECT_BASE_LIGHTSYSTEM_H
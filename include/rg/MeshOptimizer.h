@@ -0,0 +1,291 @@
+#ifndef PROJECT_BASE_MESHOPTIMIZER_H
+#define PROJECT_BASE_MESHOPTIMIZER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Import time index and vertex buffer optimisations:
+//  - weld: merges bitwise identical vertices,
+//  - optimizeVertexCache: Forsyth's linear-speed triangle ordering for the post transform cache,
+//  - optimizeOverdraw: keeps the cache friendly clusters but draws the ones facing outwards first,
+//  - optimizeVertexFetch: renumbers vertices in the order the index buffer first uses them.
+class MeshOptimizer {
+public:
+    static const int CACHE_SIZE = 32;
+
+    // removes duplicate vertices and rewrites indices, returns the new vertex count
+    template<typename V>
+    static size_t weld(std::vector<V> &vertices, std::vector<unsigned int> &indices)
+    {
+        struct Hash {
+            const std::vector<V> *vertices;
+            size_t operator()(unsigned int i) const
+            {
+                // FNV-1a over the raw bytes
+                const unsigned char *bytes = (const unsigned char *)&(*vertices)[i];
+                size_t h = 2166136261u;
+                for (size_t b = 0; b < sizeof(V); b++)
+                    h = (h ^ bytes[b]) * 16777619u;
+                return h;
+            }
+        };
+        struct Equal {
+            const std::vector<V> *vertices;
+            bool operator()(unsigned int a, unsigned int b) const
+            {
+                return std::memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(V)) == 0;
+            }
+        };
+
+        std::unordered_map<unsigned int, unsigned int, Hash, Equal> unique(vertices.size(), Hash{&vertices}, Equal{&vertices});
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<V> welded;
+        welded.reserve(vertices.size());
+
+        for (unsigned int i = 0; i < vertices.size(); i++) {
+            auto found = unique.find(i);
+            if (found != unique.end()) {
+                remap[i] = remap[found->second];
+            } else {
+                unique.emplace(i, i);
+                remap[i] = (unsigned int)welded.size();
+                welded.push_back(vertices[i]);
+            }
+        }
+
+        for (unsigned int &index : indices)
+            index = remap[index];
+        vertices.swap(welded);
+        return vertices.size();
+    }
+
+    // average cache misses per triangle for a FIFO cache of cacheSize entries, 3.0 means no reuse at all
+    static float acmr(const unsigned int *indices, size_t indexCount, size_t vertexCount, int cacheSize = 16)
+    {
+        if (indexCount == 0)
+            return 0.0f;
+
+        std::vector<unsigned int> insertedAt(vertexCount, 0);
+        unsigned int time = cacheSize + 1;
+        size_t misses = 0;
+        for (size_t i = 0; i < indexCount; i++) {
+            unsigned int v = indices[i];
+            if (time - insertedAt[v] > (unsigned int)cacheSize) {
+                insertedAt[v] = time++;
+                misses++;
+            }
+        }
+        return (float)misses / (float)(indexCount / 3);
+    }
+
+    static void optimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return;
+
+        // triangles around every vertex, the live ones are kept at the front of each range
+        std::vector<unsigned int> remaining(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; i++)
+            remaining[indices[i]]++;
+
+        std::vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + remaining[v];
+
+        std::vector<unsigned int> adjacency(indexCount);
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScores[v] = vertexScore(-1, remaining[v]);
+
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(indexCount);
+
+        std::vector<unsigned int> cache, newCache;
+        size_t cursor = 0;
+        long best = (long)(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+
+        while (best >= 0) {
+            const unsigned int *triangle = indices + best * 3;
+            emitted[best] = true;
+            result.insert(result.end(), triangle, triangle + 3);
+
+            // drop the triangle from the live adjacency of its vertices
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = triangle[k];
+                unsigned int *begin = &adjacency[offsets[v]];
+                unsigned int *end = begin + remaining[v];
+                unsigned int *found = std::find(begin, end, (unsigned int)best);
+                std::swap(*found, *(end - 1));
+                remaining[v]--;
+            }
+
+            // the triangle's vertices move to the front of the cache
+            newCache.assign(triangle, triangle + 3);
+            for (unsigned int v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    newCache.push_back(v);
+            }
+            for (size_t i = 0; i < newCache.size(); i++)
+                cachePosition[newCache[i]] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+
+            // rescore everything that was or is in the cache and pick the best triangle touching it
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int v : newCache) {
+                vertexScores[v] = vertexScore(cachePosition[v], remaining[v]);
+            }
+            for (unsigned int v : newCache) {
+                for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                    unsigned int t = adjacency[a];
+                    const unsigned int *other = indices + t * 3;
+                    triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+                    if (triangleScores[t] > bestScore) {
+                        bestScore = triangleScores[t];
+                        best = t;
+                    }
+                }
+            }
+
+            if (newCache.size() > (size_t)CACHE_SIZE)
+                newCache.resize(CACHE_SIZE);
+            cache.swap(newCache);
+
+            // nothing connected to the cache is left, continue with the first triangle not drawn yet
+            if (best < 0) {
+                while (cursor < triangleCount && emitted[cursor])
+                    cursor++;
+                if (cursor < triangleCount)
+                    best = (long)cursor;
+            }
+        }
+
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    // Splits the cache optimised order into clusters wherever a triangle misses the cache with all
+    // three vertices (where the ordering restarted) and sorts the clusters so the ones whose
+    // normal points away from the mesh center come first; they tend to occlude the rest.
+    static void optimizeOverdraw(unsigned int *indices, size_t indexCount, const std::vector<glm::vec3> &positions)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return;
+
+        std::vector<size_t> clusterStarts;
+        std::vector<unsigned int> insertedAt(positions.size(), 0);
+        unsigned int time = CACHE_SIZE + 1;
+        for (size_t t = 0; t < triangleCount; t++) {
+            int misses = 0;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                if (time - insertedAt[v] > (unsigned int)CACHE_SIZE) {
+                    insertedAt[v] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusterStarts.push_back(t);
+        }
+        clusterStarts.push_back(triangleCount);
+
+        glm::vec3 meshCenter(0.0f);
+        float meshArea = 0.0f;
+        struct Cluster { size_t begin, end; float sortKey; };
+        std::vector<Cluster> clusters;
+
+        std::vector<glm::vec3> centroids;
+        std::vector<glm::vec3> normals;
+        for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+                const glm::vec3 &a = positions[indices[t * 3]];
+                const glm::vec3 &b = positions[indices[t * 3 + 1]];
+                const glm::vec3 &p = positions[indices[t * 3 + 2]];
+                glm::vec3 n = glm::cross(b - a, p - a);
+                float triangleArea = glm::length(n);
+                centroid += (a + b + p) * (triangleArea / 3.0f);
+                normal += n;
+                area += triangleArea;
+            }
+            meshCenter += centroid;
+            meshArea += area;
+            centroids.push_back(area > 0.0f ? centroid / area : positions[indices[clusterStarts[c] * 3]]);
+            normals.push_back(glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f));
+        }
+        if (meshArea > 0.0f)
+            meshCenter /= meshArea;
+
+        for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+            float key = glm::dot(centroids[c] - meshCenter, normals[c]);
+            clusters.push_back({clusterStarts[c], clusterStarts[c + 1], key});
+        }
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) {
+            return a.sortKey > b.sortKey;
+        });
+
+        std::vector<unsigned int> result;
+        result.reserve(indexCount);
+        for (const Cluster &cluster : clusters)
+            result.insert(result.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    // vertices in first use order, unused ones are dropped, returns the new vertex count
+    template<typename V>
+    static size_t optimizeVertexFetch(std::vector<V> &vertices, std::vector<unsigned int> &indices)
+    {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<V> ordered;
+        ordered.reserve(vertices.size());
+
+        for (unsigned int &index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = (unsigned int)ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(ordered);
+        return vertices.size();
+    }
+
+private:
+    static float vertexScore(int cachePosition, unsigned int remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            // the last triangle's vertices get a fixed score so the next one does not just reuse them
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.0f - (float)(cachePosition - 3) / (CACHE_SIZE - 3), 1.5f);
+        }
+        // favour vertices with few triangles left so they do not linger as lone triangles
+        return score + 2.0f / std::sqrt((float)remaining);
+    }
+};
+
+#endif //PROJECT_BASE_MESHOPTIMIZER_H
@@ -0,0 +1,376 @@
+#ifndef PROJECT_BASE_MESH_SIMPLIFIER_H
+#define PROJECT_BASE_MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert) using half edge collapses,
+// so the simplified index buffer keeps referencing the original vertices and every LOD
+// of a mesh can share one vertex buffer.
+//
+// Vertices are connected by position rather than by index: the imported meshes are not
+// welded and split vertices along uv seams, so the same point can appear many times.
+// Groups of vertices on a seam only collapse into other seam groups, which keeps the
+// texture mapping from tearing apart.
+class MeshSimplifier {
+public:
+    struct Attributes {
+        glm::vec3 normal;
+        glm::vec2 texCoords;
+    };
+
+    // simplifies indices (a triangle list) until at most targetIndexCount indices are left or the next
+    // collapse would cost more than maxError, returns the new triangle list and stores the reached error
+    static std::vector<unsigned int> simplify(const std::vector<glm::vec3> &positions,
+                                              const std::vector<Attributes> &attributes,
+                                              const std::vector<unsigned int> &indices,
+                                              size_t targetIndexCount,
+                                              float maxError = FLT_MAX,
+                                              float *resultError = nullptr)
+    {
+        MeshSimplifier simplifier(positions, attributes, indices);
+        return simplifier.run(targetIndexCount, maxError, resultError);
+    }
+
+private:
+    // symmetric 4x4 matrix stored as its upper triangle
+    struct Quadric {
+        double a[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+        static Quadric plane(const glm::dvec3 &n, double d, double weight)
+        {
+            Quadric q;
+            q.a[0] = n.x * n.x; q.a[1] = n.x * n.y; q.a[2] = n.x * n.z; q.a[3] = n.x * d;
+            q.a[4] = n.y * n.y; q.a[5] = n.y * n.z; q.a[6] = n.y * d;
+            q.a[7] = n.z * n.z; q.a[8] = n.z * d;
+            q.a[9] = d * d;
+            for (double &v : q.a)
+                v *= weight;
+            return q;
+        }
+
+        void add(const Quadric &other)
+        {
+            for (int i = 0; i < 10; i++)
+                a[i] += other.a[i];
+        }
+
+        double error(const glm::dvec3 &p) const
+        {
+            return a[0] * p.x * p.x + 2 * a[1] * p.x * p.y + 2 * a[2] * p.x * p.z + 2 * a[3] * p.x
+                 + a[4] * p.y * p.y + 2 * a[5] * p.y * p.z + 2 * a[6] * p.y
+                 + a[7] * p.z * p.z + 2 * a[8] * p.z
+                 + a[9];
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        unsigned int from;
+        unsigned int to;
+        unsigned int fromVersion;
+        unsigned int toVersion;
+
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    const std::vector<glm::vec3> &positions;
+    const std::vector<Attributes> &attributes;
+
+    // per position group
+    std::vector<glm::dvec3> groupPosition;
+    std::vector<Quadric> quadrics;
+    std::vector<std::vector<unsigned int>> groupTriangles;
+    std::vector<std::vector<unsigned int>> groupMembers;
+    std::vector<unsigned int> version;
+    std::vector<uint8_t> seam;
+    std::vector<uint8_t> removed;
+
+    // per triangle: corners as groups and as the original vertices
+    std::vector<unsigned int> triangleGroups;
+    std::vector<unsigned int> triangleVertices;
+    std::vector<uint8_t> triangleAlive;
+    size_t aliveTriangles = 0;
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+    MeshSimplifier(const std::vector<glm::vec3> &positions, const std::vector<Attributes> &attributes,
+                   const std::vector<unsigned int> &indices)
+        : positions(positions), attributes(attributes)
+    {
+        buildGroups();
+        buildTriangles(indices);
+        buildQuadrics();
+        buildQueue();
+    }
+
+    struct PositionHash {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            uint32_t bits[3];
+            std::memcpy(bits, &p[0], sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+
+    std::vector<unsigned int> vertexGroup;
+
+    void buildGroups()
+    {
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> lookup;
+        vertexGroup.resize(positions.size());
+        for (unsigned int v = 0; v < positions.size(); v++) {
+            auto inserted = lookup.insert(std::make_pair(positions[v], (unsigned int)groupPosition.size()));
+            if (inserted.second) {
+                groupPosition.push_back(glm::dvec3(positions[v]));
+                groupMembers.push_back(std::vector<unsigned int>());
+            }
+            vertexGroup[v] = inserted.first->second;
+            groupMembers[vertexGroup[v]].push_back(v);
+        }
+
+        size_t groups = groupPosition.size();
+        quadrics.resize(groups);
+        groupTriangles.resize(groups);
+        version.assign(groups, 0);
+        removed.assign(groups, 0);
+        seam.assign(groups, 0);
+
+        for (size_t g = 0; g < groups; g++) {
+            const std::vector<unsigned int> &members = groupMembers[g];
+            for (size_t i = 1; i < members.size(); i++) {
+                if (attributeDistance(members[0], members[i]) > 1e-6f) {
+                    seam[g] = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    void buildTriangles(const std::vector<unsigned int> &indices)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            unsigned int a = vertexGroup[indices[i]];
+            unsigned int b = vertexGroup[indices[i + 1]];
+            unsigned int c = vertexGroup[indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+
+            unsigned int triangle = (unsigned int)triangleAlive.size();
+            triangleGroups.insert(triangleGroups.end(), {a, b, c});
+            triangleVertices.insert(triangleVertices.end(), {indices[i], indices[i + 1], indices[i + 2]});
+            triangleAlive.push_back(1);
+            groupTriangles[a].push_back(triangle);
+            groupTriangles[b].push_back(triangle);
+            groupTriangles[c].push_back(triangle);
+        }
+        aliveTriangles = triangleAlive.size();
+    }
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return ((uint64_t)a << 32) | b;
+    }
+
+    void buildQuadrics()
+    {
+        std::unordered_map<uint64_t, int> edgeUse;
+        for (size_t t = 0; t < triangleAlive.size(); t++) {
+            const unsigned int *g = &triangleGroups[t * 3];
+            glm::dvec3 p0 = groupPosition[g[0]], p1 = groupPosition[g[1]], p2 = groupPosition[g[2]];
+            glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+            double area = glm::length(n);
+            if (area <= 0.0)
+                continue;
+            n /= area;
+
+            // area weighted, so large triangles dominate the error
+            Quadric q = Quadric::plane(n, -glm::dot(n, p0), area * 0.5);
+            for (int i = 0; i < 3; i++) {
+                quadrics[g[i]].add(q);
+                edgeUse[edgeKey(g[i], g[(i + 1) % 3])]++;
+            }
+        }
+
+        // border edges get a perpendicular plane so the outline of open meshes survives
+        for (size_t t = 0; t < triangleAlive.size(); t++) {
+            const unsigned int *g = &triangleGroups[t * 3];
+            glm::dvec3 p0 = groupPosition[g[0]], p1 = groupPosition[g[1]], p2 = groupPosition[g[2]];
+            glm::dvec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            for (int i = 0; i < 3; i++) {
+                unsigned int a = g[i], b = g[(i + 1) % 3];
+                if (edgeUse[edgeKey(a, b)] != 1)
+                    continue;
+
+                glm::dvec3 edge = groupPosition[b] - groupPosition[a];
+                glm::dvec3 n = glm::cross(edge, faceNormal);
+                double length = glm::length(n);
+                if (length <= 0.0)
+                    continue;
+                n /= length;
+
+                Quadric q = Quadric::plane(n, -glm::dot(n, groupPosition[a]), glm::dot(edge, edge) * 10.0);
+                quadrics[a].add(q);
+                quadrics[b].add(q);
+            }
+        }
+    }
+
+    void buildQueue()
+    {
+        for (size_t t = 0; t < triangleAlive.size(); t++) {
+            const unsigned int *g = &triangleGroups[t * 3];
+            for (int i = 0; i < 3; i++) {
+                unsigned int a = g[i], b = g[(i + 1) % 3];
+                // every edge is seen from both triangles, push each direction once
+                if (a < b)
+                    pushEdge(a, b);
+            }
+        }
+    }
+
+    bool canCollapse(unsigned int from, unsigned int to) const
+    {
+        return !seam[from] || seam[to];
+    }
+
+    void pushEdge(unsigned int a, unsigned int b)
+    {
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+
+        if (canCollapse(a, b))
+            queue.push({q.error(groupPosition[b]), a, b, version[a], version[b]});
+        if (canCollapse(b, a))
+            queue.push({q.error(groupPosition[a]), b, a, version[b], version[a]});
+    }
+
+    // moving "from" onto "to" must not turn any of the remaining triangles around
+    bool flipsTriangles(unsigned int from, unsigned int to) const
+    {
+        for (unsigned int t : groupTriangles[from]) {
+            if (!triangleAlive[t])
+                continue;
+            const unsigned int *g = &triangleGroups[t * 3];
+            if (g[0] == to || g[1] == to || g[2] == to)
+                continue;
+
+            glm::dvec3 before[3], after[3];
+            for (int i = 0; i < 3; i++) {
+                before[i] = groupPosition[g[i]];
+                after[i] = g[i] == from ? groupPosition[to] : before[i];
+            }
+            glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(n0, n1) <= 0.0)
+                return true;
+        }
+        return false;
+    }
+
+    void collapse(unsigned int from, unsigned int to)
+    {
+        removed[from] = 1;
+        version[to]++;
+        quadrics[to].add(quadrics[from]);
+
+        for (unsigned int t : groupTriangles[from]) {
+            if (!triangleAlive[t])
+                continue;
+            unsigned int *g = &triangleGroups[t * 3];
+            if (g[0] == to || g[1] == to || g[2] == to) {
+                triangleAlive[t] = 0;
+                aliveTriangles--;
+                continue;
+            }
+            for (int i = 0; i < 3; i++) {
+                if (g[i] == from)
+                    g[i] = to;
+            }
+            groupTriangles[to].push_back(t);
+        }
+        groupTriangles[from].clear();
+
+        // drop dead triangles and refresh the costs of every edge around the merged group
+        std::vector<unsigned int> &triangles = groupTriangles[to];
+        triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+                                       [this](unsigned int t) { return !triangleAlive[t]; }),
+                        triangles.end());
+        for (unsigned int t : triangles) {
+            const unsigned int *g = &triangleGroups[t * 3];
+            for (int i = 0; i < 3; i++) {
+                if (g[i] != to)
+                    pushEdge(to, g[i]);
+            }
+        }
+    }
+
+    float attributeDistance(unsigned int a, unsigned int b) const
+    {
+        glm::vec3 dn = attributes[a].normal - attributes[b].normal;
+        glm::vec2 dt = attributes[a].texCoords - attributes[b].texCoords;
+        return glm::dot(dn, dn) + glm::dot(dt, dt) * 4.0f;
+    }
+
+    // the member of group that best matches the attributes of the original corner vertex
+    unsigned int matchVertex(unsigned int group, unsigned int vertex) const
+    {
+        if (vertexGroup[vertex] == group)
+            return vertex;
+
+        unsigned int best = groupMembers[group][0];
+        float bestDistance = FLT_MAX;
+        for (unsigned int candidate : groupMembers[group]) {
+            float distance = attributeDistance(candidate, vertex);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    std::vector<unsigned int> run(size_t targetIndexCount, float maxError, float *resultError)
+    {
+        double error = 0.0;
+        while (aliveTriangles * 3 > targetIndexCount && !queue.empty()) {
+            Collapse c = queue.top();
+            queue.pop();
+
+            if (removed[c.from] || removed[c.to] || version[c.from] != c.fromVersion || version[c.to] != c.toVersion)
+                continue;
+            if (c.cost > maxError)
+                break;
+            if (flipsTriangles(c.from, c.to))
+                continue;
+
+            collapse(c.from, c.to);
+            error = std::max(error, c.cost);
+        }
+
+        if (resultError)
+            *resultError = (float)std::sqrt(std::max(error, 0.0));
+
+        std::vector<unsigned int> result;
+        result.reserve(aliveTriangles * 3);
+        for (size_t t = 0; t < triangleAlive.size(); t++) {
+            if (!triangleAlive[t])
+                continue;
+            for (int i = 0; i < 3; i++)
+                result.push_back(matchVertex(triangleGroups[t * 3 + i], triangleVertices[t * 3 + i]));
+        }
+        return result;
+    }
+};
+
+#endif //PROJECT_BASE_MESH_SIMPLIFIER_H
@@ -0,0 +1,191 @@
+#ifndef PROJECT_BASE_OCCLUSIONCULLER_H
+#define PROJECT_BASE_OCCLUSIONCULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <rg/Frustum.h>
+#include <rg/GLCaps.h>
+#include <vector>
+
+// Hardware occlusion culling against the depth already in the framebuffer. The bounding box of an
+// object is rasterised inside an any-samples-passed query with color and depth writes off, then
+// the object is either drawn under conditional rendering (the GPU drops the draw once the query
+// says nothing passed) or skipped on the CPU with the newest query result that is available.
+// Results are only ever polled, the CPU never waits on the GPU.
+class OcclusionCuller {
+public:
+    enum Mode { DISABLED, CONDITIONAL_RENDER, PREVIOUS_FRAME };
+    Mode mode = CONDITIONAL_RENDER;
+
+    // boxProgram takes unit cube corners in location 0 and the uniforms viewProjection, boxMin and boxMax
+    void init(unsigned int objectCount, unsigned int boxProgram)
+    {
+        target = GLCaps::get().conservativeOcclusion ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+
+        objects.resize(objectCount);
+        for (Object &object : objects)
+            glGenQueries(1, &object.query);
+
+        program = boxProgram;
+        viewProjectionLocation = glGetUniformLocation(program, "viewProjection");
+        boxMinLocation = glGetUniformLocation(program, "boxMin");
+        boxMaxLocation = glGetUniformLocation(program, "boxMax");
+
+        float corners[] = {
+                0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+                0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f
+        };
+        unsigned char indices[] = {
+                0, 1, 2,  2, 3, 0,
+                4, 5, 6,  6, 7, 4,
+                0, 4, 7,  7, 3, 0,
+                1, 5, 6,  6, 2, 1,
+                0, 1, 5,  5, 4, 0,
+                3, 2, 6,  6, 7, 3
+        };
+
+        glGenVertexArrays(1, &boxVAO);
+        glGenBuffers(1, &boxVBO);
+        glGenBuffers(1, &boxEBO);
+        glBindVertexArray(boxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)nullptr);
+        glBindVertexArray(0);
+    }
+
+    ~OcclusionCuller()
+    {
+        for (Object &object : objects)
+            glDeleteQueries(1, &object.query);
+        glDeleteBuffers(1, &boxEBO);
+        glDeleteBuffers(1, &boxVBO);
+        glDeleteVertexArrays(1, &boxVAO);
+    }
+
+    // once per frame, before the first begin()
+    void setView(const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition, float nearPlane)
+    {
+        this->viewProjection = viewProjection;
+        this->cameraPosition = cameraPosition;
+        this->nearPlane = nearPlane;
+    }
+
+    // false means the object can be skipped, every true has to be closed with end()
+    bool begin(unsigned int id, const AABB &worldBox)
+    {
+        Object &object = objects[id];
+        object.conditional = false;
+
+        if (mode == DISABLED) {
+            object.visible = true;
+            return true;
+        }
+
+        if (object.pending) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint passed = 0;
+                glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &passed);
+                object.visible = passed != 0;
+                object.pending = false;
+            }
+        }
+
+        // with the camera inside the box the near plane clips it away, so it would always look occluded
+        AABB padded = worldBox;
+        padded.min -= glm::vec3(2.0f * nearPlane);
+        padded.max += glm::vec3(2.0f * nearPlane);
+        if (padded.contains(cameraPosition)) {
+            object.visible = true;
+            return true;
+        }
+
+        if (mode == CONDITIONAL_RENDER) {
+            issueQuery(object, worldBox);
+            glBeginConditionalRender(object.query, GL_QUERY_NO_WAIT);
+            object.conditional = true;
+            return true;
+        }
+
+        // previous frame mode: a new query goes out only after the last one was read back
+        if (!object.pending)
+            issueQuery(object, worldBox);
+        return object.visible;
+    }
+
+    void end(unsigned int id)
+    {
+        if (objects[id].conditional)
+            glEndConditionalRender();
+    }
+
+    // newest known result, in conditional mode it lags a few frames behind what the GPU used
+    bool occluded(unsigned int id) const { return !objects[id].visible; }
+
+    unsigned int occludedCount() const
+    {
+        unsigned int count = 0;
+        for (const Object &object : objects)
+            count += object.visible ? 0 : 1;
+        return count;
+    }
+
+    bool conservative() const { return target == GL_ANY_SAMPLES_PASSED_CONSERVATIVE; }
+
+private:
+    struct Object {
+        unsigned int query = 0;
+        bool pending = false;
+        bool visible = true;
+        bool conditional = false;
+    };
+
+    std::vector<Object> objects;
+    GLenum target = GL_ANY_SAMPLES_PASSED;
+
+    unsigned int program = 0;
+    int viewProjectionLocation = -1, boxMinLocation = -1, boxMaxLocation = -1;
+    unsigned int boxVAO = 0, boxVBO = 0, boxEBO = 0;
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float nearPlane = 0.1f;
+
+    void issueQuery(Object &object, const AABB &box)
+    {
+        // the caller may be drawing without depth writes, like the transparency layer, so the masks go back as they were
+        GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+        GLboolean depthMask;
+        GLboolean colorMask[4];
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+        glDisable(GL_CULL_FACE);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+
+        glUseProgram(program);
+        glUniformMatrix4fv(viewProjectionLocation, 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform3fv(boxMinLocation, 1, glm::value_ptr(box.min));
+        glUniform3fv(boxMaxLocation, 1, glm::value_ptr(box.max));
+
+        glBeginQuery(target, object.query);
+        glBindVertexArray(boxVAO);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)nullptr);
+        glBindVertexArray(0);
+        glEndQuery(target);
+        object.pending = true;
+
+        glDepthMask(depthMask);
+        glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+        if (cullFace)
+            glEnable(GL_CULL_FACE);
+    }
+};
+
+#endif //PROJECT_BASE_OCCLUSIONCULLER_H
@@ -0,0 +1,138 @@
+#ifndef PROJECT_BASE_POSTPROCESS_H
+#define PROJECT_BASE_POSTPROCESS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <map>
+#include <memory>
+#include <string>
+
+// Everything after the scene and bloom passes in one full screen triangle: the half resolution
+// transparent layer, bloom composite, exposure tonemapping, gamma, FXAA and vignette. Each combination of enabled effects is its own
+// program, compiled from post.fs with the matching defines the first time it is used, so disabled
+// effects cost nothing and the frame reads the scene and writes the framebuffer exactly once.
+class PostProcess {
+public:
+    enum Flags {
+        BLOOM = 1 << 0,
+        FXAA = 1 << 1,
+        VIGNETTE = 1 << 2,
+        GAMMA = 1 << 3,
+        TRANSPARENCY = 1 << 4
+    };
+
+    bool fxaa = false;
+    bool vignette = false;
+    float vignetteStrength = 0.35f;
+    // off keeps the look of the original composite, the textures are not loaded as sRGB
+    bool gammaCorrect = false;
+    float gamma = 2.2f;
+
+    void init(const char *vertexPath, const char *fragmentPath)
+    {
+        this->vertexPath = vertexPath;
+        this->fragmentPath = fragmentPath;
+        // core profile wants a vertex array bound even when the vertex shader makes up the vertices
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // transparent layer for the next render(), composited over the scene with a bilateral upsample
+    // against the two depth textures, of which the lower left layerScale part was rendered; layer 0
+    // when the transparent geometry is in the scene itself
+    void setTransparency(unsigned int layer, unsigned int layerDepth, unsigned int sceneDepth, glm::vec2 layerScale,
+                         glm::vec2 depthRange)
+    {
+        transparencyLayer = layer;
+        transparencyDepth = layerDepth;
+        this->sceneDepth = sceneDepth;
+        this->layerScale = layerScale;
+        this->depthRange = depthRange;
+    }
+
+    ~PostProcess()
+    {
+        if (emptyVAO)
+            glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    // draws into the bound framebuffer over the current viewport, bloom is 0 when there is no glow
+    void render(unsigned int scene, glm::vec2 sceneScale, unsigned int bloom, float bloomStrength, float exposure,
+                glm::ivec2 outputSize)
+    {
+        unsigned int flags = (bloom ? BLOOM : 0) | (fxaa ? FXAA : 0) | (vignette ? VIGNETTE : 0) | (gammaCorrect ? GAMMA : 0) |
+                             (transparencyLayer ? TRANSPARENCY : 0);
+        Shader &shader = program(flags);
+        shader.use();
+        shader.setInt("scene", 0);
+        shader.setInt("bloomBlur", 1);
+        shader.setFloat("bloomStrength", bloomStrength);
+        shader.setFloat("exposure", exposure);
+        shader.setFloat("gamma", gamma);
+        shader.setFloat("vignetteStrength", vignetteStrength);
+        shader.setVec2("sceneScale", sceneScale);
+        shader.setVec2("texelSize", glm::vec2(1.0f) / glm::vec2(outputSize));
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, scene);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, bloom);
+        if (transparencyLayer) {
+            shader.setInt("transparency", 2);
+            shader.setInt("transparencyDepth", 3);
+            shader.setInt("sceneDepth", 4);
+            shader.setVec2("depthRange", depthRange);
+            shader.setVec2("layerScale", layerScale);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, transparencyLayer);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, transparencyDepth);
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_2D, sceneDepth);
+        }
+
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    size_t programCount() const { return programs.size(); }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    unsigned int emptyVAO = 0;
+    unsigned int transparencyLayer = 0;
+    unsigned int transparencyDepth = 0;
+    unsigned int sceneDepth = 0;
+    glm::vec2 layerScale = glm::vec2(1.0f);
+    glm::vec2 depthRange = glm::vec2(0.1f, 100.0f);
+    std::map<unsigned int, std::unique_ptr<Shader>> programs;
+
+    Shader &program(unsigned int flags)
+    {
+        auto found = programs.find(flags);
+        if (found != programs.end())
+            return *found->second;
+
+        std::string defines;
+        if (flags & BLOOM)
+            defines += "#define BLOOM\n";
+        if (flags & FXAA)
+            defines += "#define FXAA\n";
+        if (flags & VIGNETTE)
+            defines += "#define VIGNETTE\n";
+        if (flags & GAMMA)
+            defines += "#define GAMMA\n";
+        if (flags & TRANSPARENCY)
+            defines += "#define TRANSPARENCY\n";
+
+        std::unique_ptr<Shader> shader(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines.c_str()));
+        Shader &result = *shader;
+        programs[flags] = std::move(shader);
+        return result;
+    }
+};
+
+#endif //PROJECT_BASE_POSTPROCESS_H
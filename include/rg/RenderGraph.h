@@ -0,0 +1,301 @@
+#ifndef PROJECT_BASE_RENDERGRAPH_H
+#define PROJECT_BASE_RENDERGRAPH_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/GpuTimer.h>
+#include <rg/RenderTargetPool.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Frame graph over render targets, rebuilt every frame:
+//  - passes are added with the function that records them and declare what they create, read and write,
+//  - compile() culls every pass whose results nobody reads (passes writing an imported target, like
+//    the default framebuffer, are kept) and orders the rest by their dependencies,
+//  - execute() acquires each transient target from the pool right before its first use and releases it
+//    after its last one, so targets whose lifetimes do not overlap share the same memory.
+// Writing a resource gives a new version of it and depends on the previous one, so passes drawing over
+// the same target keep their order.
+class RenderGraph {
+public:
+    // a version of a resource, -1 for none
+    typedef int Resource;
+
+    struct TargetDesc {
+        GLenum format;
+        int width, height;
+        GLenum depthFormat;
+        int samples;
+        // see RenderTargetPool::acquire, left out for a single color attachment
+        GLenum extraFormats[RenderTarget::MAX_EXTRA_ATTACHMENTS] = {};
+    };
+
+    class Registry;
+
+    class Builder {
+    public:
+        // a transient target that this pass renders first
+        Resource create(const char *name, const TargetDesc &desc)
+        {
+            Physical physical;
+            physical.name = name;
+            physical.desc = desc;
+            return graph->addVersion(graph->addPhysical(physical), pass);
+        }
+
+        // a transient target the pass takes from the pool itself and hands over with Registry::provide
+        Resource provided(const char *name)
+        {
+            Physical physical;
+            physical.name = name;
+            physical.provided = true;
+            return graph->addVersion(graph->addPhysical(physical), pass);
+        }
+
+        Resource read(Resource resource)
+        {
+            ASSERT(resource >= 0, "Render graph pass reads a resource that was never created");
+            graph->passes[pass].reads.push_back(resource);
+            return resource;
+        }
+
+        // draws over what the resource holds, returns the new version
+        Resource write(Resource resource)
+        {
+            read(resource);
+            int physical = graph->versions[resource].physical;
+            if (graph->physicals[physical].imported)
+                graph->passes[pass].sideEffect = true;
+            return graph->addVersion(physical, pass);
+        }
+
+    private:
+        friend class RenderGraph;
+        Builder(RenderGraph *graph, int pass) : graph(graph), pass(pass) {}
+
+        RenderGraph *graph;
+        int pass;
+    };
+
+    class Registry {
+    public:
+        RenderTarget &target(Resource resource) const
+        {
+            RenderTarget *target = graph->physicals[graph->versions[resource].physical].target;
+            ASSERT(target != nullptr, "Render graph resource has no target");
+            return *target;
+        }
+
+        // pooled false for a target the pass keeps across frames, the graph does not release it then
+        void provide(Resource resource, RenderTarget *target, bool pooled = true) const
+        {
+            Physical &physical = graph->physicals[graph->versions[resource].physical];
+            ASSERT(physical.provided, "Render graph resource is not provided by its pass");
+            physical.target = target;
+            physical.pooled = pooled;
+        }
+
+    private:
+        friend class RenderGraph;
+        explicit Registry(RenderGraph *graph) : graph(graph) {}
+
+        RenderGraph *graph;
+    };
+
+    // what the last frame ran, for the settings window
+    struct PassInfo {
+        const char *name;
+        bool culled;
+    };
+
+    void init(RenderTargetPool *pool)
+    {
+        this->pool = pool;
+    }
+
+    // a target that lives outside the graph, a pass writing it is never culled
+    Resource importTarget(const char *name, RenderTarget *target)
+    {
+        Physical physical;
+        physical.name = name;
+        physical.imported = true;
+        physical.target = target;
+        return addVersion(addPhysical(physical), -1);
+    }
+
+    // name has to be a string literal, it is also the GPU timer section
+    Builder addPass(const char *name, std::function<void(const Registry &)> execute)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.execute = std::move(execute);
+        passes.push_back(std::move(pass));
+        return Builder(this, (int)passes.size() - 1);
+    }
+
+    void compile()
+    {
+        // culling: a pass stays while something reads one of its versions
+        std::vector<int> refCounts(passes.size(), 0);
+        std::vector<int> readers(versions.size(), 0);
+        for (const Pass &pass : passes) {
+            for (Resource resource : pass.reads)
+                readers[resource]++;
+        }
+        for (size_t v = 0; v < versions.size(); v++) {
+            if (versions[v].producer >= 0)
+                refCounts[versions[v].producer]++;
+        }
+
+        std::vector<Resource> unread;
+        for (size_t v = 0; v < versions.size(); v++) {
+            if (readers[v] == 0 && versions[v].producer >= 0)
+                unread.push_back((Resource)v);
+        }
+        while (!unread.empty()) {
+            Resource resource = unread.back();
+            unread.pop_back();
+            Pass &producer = passes[versions[resource].producer];
+            if (--refCounts[versions[resource].producer] > 0 || producer.sideEffect || producer.culled)
+                continue;
+            producer.culled = true;
+            for (Resource read : producer.reads) {
+                if (--readers[read] == 0 && versions[read].producer >= 0)
+                    unread.push_back(read);
+            }
+        }
+
+        // ordering: a pass runs once the producers of everything it reads have run, ties in the order they were added
+        std::vector<int> waiting(passes.size(), 0);
+        for (size_t p = 0; p < passes.size(); p++) {
+            for (Resource read : passes[p].reads) {
+                if (versions[read].producer >= 0 && versions[read].producer != (int)p)
+                    waiting[p]++;
+            }
+        }
+        order.clear();
+        std::vector<bool> done(passes.size(), false);
+        for (;;) {
+            int next = -1;
+            for (size_t p = 0; p < passes.size() && next < 0; p++) {
+                if (!done[p] && waiting[p] == 0)
+                    next = (int)p;
+            }
+            if (next < 0)
+                break;
+            done[next] = true;
+            if (!passes[next].culled)
+                order.push_back(next);
+            for (size_t p = 0; p < passes.size(); p++) {
+                for (Resource read : passes[p].reads) {
+                    if (versions[read].producer == next && (int)p != next)
+                        waiting[p]--;
+                }
+            }
+        }
+        ASSERT(std::count(done.begin(), done.end(), true) == (long)passes.size(), "Render graph has a cycle");
+
+        // lifetimes of the physical targets over the executed passes
+        for (size_t i = 0; i < order.size(); i++) {
+            const Pass &pass = passes[order[i]];
+            for (size_t v = 0; v < versions.size(); v++) {
+                bool used = versions[v].producer == order[i] ||
+                            std::find(pass.reads.begin(), pass.reads.end(), (Resource)v) != pass.reads.end();
+                if (!used)
+                    continue;
+                Physical &physical = physicals[versions[v].physical];
+                if (physical.firstUse < 0)
+                    physical.firstUse = (int)i;
+                physical.lastUse = (int)i;
+            }
+        }
+    }
+
+    // runs the compiled passes and starts over for the next frame
+    void execute(GpuTimer *timer = nullptr)
+    {
+        Registry registry(this);
+        for (size_t i = 0; i < order.size(); i++) {
+            for (Physical &physical : physicals) {
+                if (physical.firstUse == (int)i && !physical.imported && !physical.provided) {
+                    const TargetDesc &desc = physical.desc;
+                    physical.target = pool->acquire(desc.format, desc.width, desc.height, desc.depthFormat, desc.samples, desc.extraFormats);
+                }
+            }
+
+            Pass &pass = passes[order[i]];
+            if (timer)
+                timer->mark(pass.name);
+            pass.execute(registry);
+
+            for (Physical &physical : physicals) {
+                if (physical.lastUse == (int)i && !physical.imported && physical.pooled)
+                    pool->release(physical.target);
+            }
+        }
+
+        lastFrame.clear();
+        for (const Pass &pass : passes)
+            lastFrame.push_back({pass.name, pass.culled});
+        transientCount = (size_t)std::count_if(physicals.begin(), physicals.end(), [](const Physical &physical) {
+            return !physical.imported && physical.firstUse >= 0;
+        });
+
+        passes.clear();
+        versions.clear();
+        physicals.clear();
+        order.clear();
+    }
+
+    const std::vector<PassInfo> &lastPasses() const { return lastFrame; }
+    size_t lastTransientCount() const { return transientCount; }
+
+private:
+    struct Pass {
+        const char *name = nullptr;
+        std::function<void(const Registry &)> execute;
+        std::vector<Resource> reads;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    struct Physical {
+        const char *name = nullptr;
+        TargetDesc desc = {};
+        RenderTarget *target = nullptr;
+        bool imported = false;
+        bool provided = false;
+        bool pooled = true;
+        int firstUse = -1, lastUse = -1;
+    };
+
+    struct Version {
+        int physical;
+        int producer;
+    };
+
+    RenderTargetPool *pool = nullptr;
+    std::vector<Pass> passes;
+    std::vector<Physical> physicals;
+    std::vector<Version> versions;
+    std::vector<int> order;
+
+    std::vector<PassInfo> lastFrame;
+    size_t transientCount = 0;
+
+    int addPhysical(const Physical &physical)
+    {
+        physicals.push_back(physical);
+        return (int)physicals.size() - 1;
+    }
+
+    Resource addVersion(int physical, int producer)
+    {
+        versions.push_back({physical, producer});
+        return (Resource)versions.size() - 1;
+    }
+};
+
+#endif //PROJECT_BASE_RENDERGRAPH_H
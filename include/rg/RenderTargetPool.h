@@ -0,0 +1,230 @@
+#ifndef PROJECT_BASE_RENDERTARGETPOOL_H
+#define PROJECT_BASE_RENDERTARGETPOOL_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// framebuffer with one linearly filtered, edge clamped color texture and an optional depth texture;
+// a multisampled target has renderbuffers instead of both textures and is resolved with a blit.
+// Single sampled targets may have extra color textures on the following attachments, for passes
+// writing more than one output.
+struct RenderTarget {
+    static const int MAX_EXTRA_ATTACHMENTS = 3;
+
+    unsigned int fbo = 0;
+    unsigned int texture = 0;
+    unsigned int extraTextures[MAX_EXTRA_ATTACHMENTS] = {};
+    unsigned int depthTexture = 0;
+    unsigned int depth = 0;
+    unsigned int colorRenderbuffer = 0;
+
+    GLenum format = GL_RGBA16F;
+    GLenum depthFormat = 0;
+    // 0 where there is no attachment
+    GLenum extraFormats[MAX_EXTRA_ATTACHMENTS] = {};
+    int width = 0, height = 0;
+    int samples = 0;
+
+    bool inUse = false;
+    unsigned int lastUsedFrame = 0;
+
+    size_t bytes() const
+    {
+        size_t pixel = formatBytes(format) + (depthFormat ? 4 : 0);
+        for (GLenum extra : extraFormats)
+            pixel += extra ? formatBytes(extra) : 0;
+        return (size_t)width * height * std::max(1, samples) * pixel;
+    }
+
+    bool sameExtraFormats(const GLenum *formats) const
+    {
+        for (int i = 0; i < MAX_EXTRA_ATTACHMENTS; i++) {
+            if (extraFormats[i] != (formats ? formats[i] : 0))
+                return false;
+        }
+        return true;
+    }
+
+    static size_t formatBytes(GLenum format)
+    {
+        switch (format) {
+            case GL_RGBA32F: return 16;
+            case GL_RGBA16F: return 8;
+            case GL_RG16F: return 4;
+            case GL_RGB10_A2: return 4;
+            case GL_RGBA8: return 4;
+            case GL_R11F_G11F_B10F: return 4;
+            case GL_R16F: return 2;
+            default: return 4;
+        }
+    }
+};
+
+// Hands out render targets by format and size. Passes acquire a target for as long as they read or
+// write it and release it afterwards, so a later pass asking for the same format and size gets the
+// same textures back instead of a new allocation. Targets nobody asked for in the last few frames,
+// like the ones of the old size after a window resize, are deleted in beginFrame().
+class RenderTargetPool {
+public:
+    // frames a free target survives without being acquired
+    static const unsigned int MAX_IDLE_FRAMES = 3;
+
+    ~RenderTargetPool()
+    {
+        for (auto &target : targets)
+            destroy(*target);
+    }
+
+    void beginFrame()
+    {
+        frame++;
+        for (size_t i = 0; i < targets.size();) {
+            RenderTarget &target = *targets[i];
+            if (!target.inUse && frame - target.lastUsedFrame > MAX_IDLE_FRAMES) {
+                destroy(target);
+                targets[i] = std::move(targets.back());
+                targets.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    // a free target matching the request or a new one, depthFormat 0 means no depth buffer and
+    // samples 0 a single sampled target with a texture; extraFormats are the formats of the
+    // attachments after the first, MAX_EXTRA_ATTACHMENTS of them with 0 for none
+    RenderTarget *acquire(GLenum format, int width, int height, GLenum depthFormat = 0, int samples = 0,
+                          const GLenum *extraFormats = nullptr)
+    {
+        ASSERT(width > 0 && height > 0, "Render target has to have a size");
+        ASSERT(samples == 0 || !extraFormats || !extraFormats[0], "Multisampled render targets have one color attachment");
+
+        for (auto &target : targets) {
+            if (!target->inUse && target->format == format && target->depthFormat == depthFormat &&
+                target->width == width && target->height == height && target->samples == samples &&
+                target->sameExtraFormats(extraFormats)) {
+                target->inUse = true;
+                target->lastUsedFrame = frame;
+                return target.get();
+            }
+        }
+
+        targets.emplace_back(new RenderTarget);
+        RenderTarget &target = *targets.back();
+        target.format = format;
+        target.depthFormat = depthFormat;
+        target.width = width;
+        target.height = height;
+        target.samples = samples;
+        for (int i = 0; extraFormats && i < RenderTarget::MAX_EXTRA_ATTACHMENTS; i++)
+            target.extraFormats[i] = extraFormats[i];
+        create(target);
+        target.inUse = true;
+        target.lastUsedFrame = frame;
+        return &target;
+    }
+
+    void release(RenderTarget *target)
+    {
+        if (target)
+            target->inUse = false;
+    }
+
+    size_t targetCount() const { return targets.size(); }
+
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (const auto &target : targets)
+            total += target->bytes();
+        return total;
+    }
+
+private:
+    std::vector<std::unique_ptr<RenderTarget>> targets;
+    unsigned int frame = 0;
+
+    static void create(RenderTarget &target)
+    {
+        glGenFramebuffers(1, &target.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+
+        if (target.samples > 0) {
+            glGenRenderbuffers(1, &target.colorRenderbuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, target.colorRenderbuffer);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, target.samples, target.format, target.width, target.height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorRenderbuffer);
+        } else {
+            target.texture = createTexture(target.format, target.width, target.height);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+
+            GLenum drawBuffers[1 + RenderTarget::MAX_EXTRA_ATTACHMENTS] = {GL_COLOR_ATTACHMENT0};
+            int count = 1;
+            for (; count <= RenderTarget::MAX_EXTRA_ATTACHMENTS && target.extraFormats[count - 1]; count++) {
+                target.extraTextures[count - 1] = createTexture(target.extraFormats[count - 1], target.width, target.height);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + count, GL_TEXTURE_2D, target.extraTextures[count - 1], 0);
+                drawBuffers[count] = GL_COLOR_ATTACHMENT0 + count;
+            }
+            if (count > 1)
+                glDrawBuffers(count, drawBuffers);
+        }
+
+        if (target.depthFormat && target.samples > 0) {
+            glGenRenderbuffers(1, &target.depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, target.samples, target.depthFormat, target.width, target.height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+        } else if (target.depthFormat) {
+            // a texture, so later passes can reconstruct positions from it
+            glGenTextures(1, &target.depthTexture);
+            glBindTexture(GL_TEXTURE_2D, target.depthTexture);
+            glTexImage2D(GL_TEXTURE_2D, 0, target.depthFormat, target.width, target.height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depthTexture, 0);
+        }
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Render target framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    static unsigned int createTexture(GLenum format, int width, int height)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // filters read past the edges
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    static void destroy(RenderTarget &target)
+    {
+        glDeleteFramebuffers(1, &target.fbo);
+        if (target.texture)
+            glDeleteTextures(1, &target.texture);
+        for (unsigned int &extra : target.extraTextures) {
+            if (extra)
+                glDeleteTextures(1, &extra);
+        }
+        if (target.colorRenderbuffer)
+            glDeleteRenderbuffers(1, &target.colorRenderbuffer);
+        if (target.depth)
+            glDeleteRenderbuffers(1, &target.depth);
+        if (target.depthTexture)
+            glDeleteTextures(1, &target.depthTexture);
+    }
+};
+
+#endif //PROJECT_BASE_RENDERTARGETPOOL_H
@@ -0,0 +1,127 @@
+#ifndef PROJECT_BASE_RINGBUFFER_H
+#define PROJECT_BASE_RINGBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/GLCaps.h>
+#include <cstring>
+
+// Linear allocator for data that changes every frame (uniform blocks, instance data).
+// With buffer storage the buffer is mapped once, persistently and coherently, and split into
+// FRAMES regions; a fence per region makes sure the GPU is done with it before the CPU writes
+// into it again, so an upload is a plain memcpy. Without it the buffer is filled front to back
+// with unsynchronized maps and orphaned at the start of a frame that no longer fits behind the
+// head, letting the driver rename it. Never in the middle of a frame: ranges bound earlier in
+// the frame would point into the discarded storage.
+class RingBuffer {
+public:
+    static const unsigned int FRAMES = 3;
+
+    // frameSize is how much a single frame may allocate, alignment applies to every allocation
+    void init(GLenum target, GLsizeiptr frameSize, GLint alignment)
+    {
+        this->target = target;
+        this->frameSize = frameSize;
+        this->alignment = alignment;
+
+        glGenBuffers(1, &id);
+        glBindBuffer(target, id);
+
+        PFN_glBufferStorage bufferStorage = GLCaps::get().bufferStorage;
+        if (bufferStorage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(target, frameSize * FRAMES, nullptr, flags);
+            mapped = (char *)glMapBufferRange(target, 0, frameSize * FRAMES, flags);
+        }
+        if (!mapped)
+            glBufferData(target, frameSize * FRAMES, nullptr, GL_STREAM_DRAW);
+
+        glBindBuffer(target, 0);
+    }
+
+    ~RingBuffer()
+    {
+        for (GLsync &fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        if (mapped) {
+            glBindBuffer(target, id);
+            glUnmapBuffer(target);
+        }
+        glDeleteBuffers(1, &id);
+    }
+
+    // start of a frame, blocks only when the GPU is still FRAMES frames behind
+    void beginFrame()
+    {
+        if (!mapped) {
+            if (head + frameSize > frameSize * FRAMES) {
+                // everything written so far may still be in flight, take a fresh buffer
+                glBindBuffer(target, id);
+                glBufferData(target, frameSize * FRAMES, nullptr, GL_STREAM_DRAW);
+                glBindBuffer(target, 0);
+                head = 0;
+            }
+            end = head + frameSize;
+            return;
+        }
+
+        region = (region + 1) % FRAMES;
+        head = region * frameSize;
+        end = head + frameSize;
+
+        GLsync &fence = fences[region];
+        if (fence) {
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            while (status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    // after the last draw that reads this frame's data
+    void endFrame()
+    {
+        if (mapped)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // copies size bytes in and returns their offset inside buffer()
+    GLintptr upload(const void *data, GLsizeiptr size)
+    {
+        GLintptr offset = (head + alignment - 1) / alignment * alignment;
+        ASSERT(offset + size <= end, "Ring buffer frame region overflow");
+
+        if (mapped) {
+            std::memcpy(mapped + offset, data, size);
+        } else {
+            glBindBuffer(target, id);
+            void *range = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            std::memcpy(range, data, size);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+
+        head = offset + size;
+        return offset;
+    }
+
+    unsigned int buffer() const { return id; }
+    bool persistent() const { return mapped != nullptr; }
+
+private:
+    GLenum target = GL_UNIFORM_BUFFER;
+    unsigned int id = 0;
+    GLsizeiptr frameSize = 0;
+    GLint alignment = 1;
+
+    char *mapped = nullptr;
+    GLsync fences[FRAMES] = {};
+    unsigned int region = 0;
+    GLintptr head = 0;
+    GLintptr end = 0;
+};
+
+#endif //PROJECT_BASE_RINGBUFFER_H
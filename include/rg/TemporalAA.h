@@ -0,0 +1,140 @@
+#ifndef PROJECT_BASE_TEMPORALAA_H
+#define PROJECT_BASE_TEMPORALAA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+#include <rg/RenderTargetPool.h>
+
+// Temporal upsampling of the scene. The scene renders at renderScale of the output with its projection
+// moved by a sub-pixel Halton offset every frame, and resolve() accumulates those frames into a history
+// at output resolution. Every output pixel finds where it was last frame from the scene depth and the
+// camera, minus the object motion the scene pass wrote into its velocity attachment, and blends the
+// history there with the new sample. The history is clamped to the colour range of the new samples
+// around the pixel first, so disoccluded or changed surfaces do not ghost.
+class TemporalAA {
+public:
+    // scene resolution relative to the output
+    float renderScale = 0.67f;
+    // share of the history kept every frame
+    float feedback = 0.9f;
+
+    static const unsigned int JITTER_SAMPLES = 8;
+
+    // drawQuad draws a full screen quad
+    void init(RenderTargetPool *pool, Shader *resolveShader, void (*drawQuad)())
+    {
+        this->pool = pool;
+        this->resolveShader = resolveShader;
+        this->drawQuad = drawQuad;
+    }
+
+    ~TemporalAA()
+    {
+        releaseHistory();
+    }
+
+    // moves on to the next jitter, once per frame before the projection is made
+    void beginFrame()
+    {
+        jitterIndex = (jitterIndex + 1) % JITTER_SAMPLES;
+    }
+
+    // offset of this frame in scene pixels, within half a pixel of the centre
+    glm::vec2 jitter() const
+    {
+        return glm::vec2(halton(jitterIndex + 1, 2), halton(jitterIndex + 1, 3)) - 0.5f;
+    }
+
+    // projection moved by the jitter, for a scene rendered into a sceneSize viewport
+    glm::mat4 jittered(const glm::mat4 &projection, glm::ivec2 sceneSize) const
+    {
+        glm::vec2 offset = jitter() * 2.0f / glm::vec2(sceneSize);
+        return glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f)) * projection;
+    }
+
+    // Accumulates scene, of which the lower left sceneScale part was rendered with jittered(), into the
+    // history. scene has the velocity as its first extra attachment and a depth texture; the matrices
+    // are without jitter. The returned history target stays with the TAA, the caller must not release it.
+    RenderTarget *resolve(const RenderTarget &scene, glm::vec2 sceneScale, glm::ivec2 outputSize,
+                          const glm::mat4 &viewProjection, const glm::mat4 &previousViewProjection)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        bool reset = !history[0] || history[0]->width != outputSize.x || history[0]->height != outputSize.y ||
+                     history[0]->format != scene.format;
+        if (reset) {
+            releaseHistory();
+            history[0] = pool->acquire(scene.format, outputSize.x, outputSize.y);
+            history[1] = pool->acquire(scene.format, outputSize.x, outputSize.y);
+        }
+
+        RenderTarget *previous = history[historyIndex];
+        RenderTarget *next = history[1 - historyIndex];
+        glBindFramebuffer(GL_FRAMEBUFFER, next->fbo);
+        glViewport(0, 0, next->width, next->height);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, scene.texture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, scene.extraTextures[0]);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, scene.depthTexture);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, previous->texture);
+
+        resolveShader->use();
+        resolveShader->setInt("scene", 0);
+        resolveShader->setInt("velocity", 1);
+        resolveShader->setInt("depth", 2);
+        resolveShader->setInt("history", 3);
+        resolveShader->setVec2("sceneScale", sceneScale);
+        resolveShader->setVec2("jitter", jitter() / glm::vec2(scene.width, scene.height));
+        resolveShader->setMat4("inverseViewProjection", glm::inverse(viewProjection));
+        resolveShader->setMat4("previousViewProjection", previousViewProjection);
+        resolveShader->setFloat("feedback", feedback);
+        resolveShader->setBool("reset", reset);
+        drawQuad();
+        glActiveTexture(GL_TEXTURE0);
+
+        historyIndex = 1 - historyIndex;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return next;
+    }
+
+    // gives the history back to the pool, when the upsampler is switched off
+    void releaseHistory()
+    {
+        if (!history[0])
+            return;
+        pool->release(history[0]);
+        pool->release(history[1]);
+        history[0] = history[1] = nullptr;
+    }
+
+private:
+    RenderTargetPool *pool = nullptr;
+    Shader *resolveShader = nullptr;
+    void (*drawQuad)() = nullptr;
+
+    unsigned int jitterIndex = 0;
+    RenderTarget *history[2] = {nullptr, nullptr};
+    int historyIndex = 0;
+
+    // radical inverse of index in base, evenly spread points in [0, 1)
+    static float halton(unsigned int index, unsigned int base)
+    {
+        float result = 0.0f;
+        float fraction = 1.0f;
+        while (index > 0) {
+            fraction /= (float)base;
+            result += fraction * (float)(index % base);
+            index /= base;
+        }
+        return result;
+    }
+};
+
+#endif //PROJECT_BASE_TEMPORALAA_H
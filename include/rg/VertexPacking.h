@@ -0,0 +1,69 @@
+#ifndef PROJECT_BASE_VERTEXPACKING_H
+#define PROJECT_BASE_VERTEXPACKING_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <rg/Frustum.h>
+#include <cmath>
+#include <cstdint>
+
+// GPU vertex layout, 16 bytes instead of the 56 of fp32 Vertex. No shader does normal mapping,
+// so the tangent frame is not stored at all
+struct PackedVertex {
+    uint16_t position[4]; // unorm16 inside the mesh bounds, w is padding
+    int16_t normal[2];    // octahedral, snorm16
+    uint32_t texCoords;   // two half floats
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex has to stay tightly packed");
+
+// Quantises vertices at import. Positions are stored relative to the mesh bounds, the vertex shader
+// gets positionOffset and positionScale to undo it.
+class VertexPacker {
+public:
+    static PackedVertex pack(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoords, const AABB &bounds)
+    {
+        PackedVertex result;
+
+        glm::vec3 t = (position - positionOffset(bounds)) / positionScale(bounds);
+        for (int i = 0; i < 3; i++)
+            result.position[i] = (uint16_t)std::lround(glm::clamp(t[i], 0.0f, 1.0f) * 65535.0f);
+        result.position[3] = 0;
+
+        glm::vec2 octahedral = octahedralEncode(normal);
+        result.normal[0] = (int16_t)std::lround(octahedral.x * 32767.0f);
+        result.normal[1] = (int16_t)std::lround(octahedral.y * 32767.0f);
+
+        result.texCoords = glm::packHalf2x16(texCoords);
+        return result;
+    }
+
+    static glm::vec3 positionOffset(const AABB &bounds)
+    {
+        return bounds.min;
+    }
+
+    // a flat mesh still needs a non zero scale on its flat axis
+    static glm::vec3 positionScale(const AABB &bounds)
+    {
+        return glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+    }
+
+    // unit vector onto the [-1, 1] square, the lower hemisphere is folded over the diagonals;
+    // degenerate and missing normals come out of the importer as zero and are stored as +z
+    static glm::vec2 octahedralEncode(const glm::vec3 &n)
+    {
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (!(l1 > 0.0f))
+            return glm::vec2(0.0f);
+        glm::vec3 v = n / l1;
+        glm::vec2 e(v.x, v.y);
+        if (v.z < 0.0f) {
+            e = glm::vec2((1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+                          (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return e;
+    }
+};
+
+#endif //PROJECT_BASE_VERTEXPACKING_H
@@ -0,0 +1,28 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform float threshold;
+// a quarter of the scene texels one target pixel covers, in uv
+uniform vec2 tapOffset;
+// part of the scene texture covered by the scaled viewport
+uniform vec2 sceneScale;
+
+vec3 bright(vec2 uv) {
+    uv = min(uv * sceneScale, sceneScale - 0.5 / vec2(textureSize(scene, 0)));
+    vec3 color = texture(scene, uv).rgb;
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return brightness > threshold ? color : vec3(0.0);
+}
+
+// runs at reduced resolution, four bilinear taps cover the whole footprint of the pixel in the scene
+void main() {
+    vec3 result = bright(TexCoords + tapOffset * vec2(-1.0,  1.0));
+    result += bright(TexCoords + tapOffset * vec2( 1.0,  1.0));
+    result += bright(TexCoords + tapOffset * vec2(-1.0, -1.0));
+    result += bright(TexCoords + tapOffset * vec2( 1.0, -1.0));
+
+    FragColor = vec4(result * 0.25, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+
+// 13 bilinear taps over a 6x6 texel footprint (Jimenez, Call of Duty: Advanced Warfare),
+// the overlapping boxes keep the halving free of the flicker a single 2x2 box gives
+void main() {
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+
+    vec3 a = texture(source, TexCoords + texel * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, TexCoords + texel * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, TexCoords + texel * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, TexCoords + texel * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + texel * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, TexCoords + texel * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, TexCoords + texel * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, TexCoords + texel * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, TexCoords + texel * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, TexCoords + texel * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, TexCoords + texel * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, TexCoords + texel * vec2( 1.0, -1.0)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// glow of this frame, only read when the chain ran
+uniform sampler2D current;
+// last written glow, its alpha is the view depth of the pixel it was made for
+uniform sampler2D history;
+uniform sampler2D depth;
+uniform bool updated;
+// share of the reprojected history kept when the chain ran
+uniform float historyWeight;
+uniform mat4 viewProjection;
+uniform mat4 inverseViewProjection;
+uniform mat4 historyViewProjection;
+// part of the depth texture covered by the scaled viewport
+uniform vec2 depthScale;
+// relative view depth difference above which the history shows something else
+uniform float depthTolerance;
+
+void main() {
+    vec2 depthCoords = min(TexCoords * depthScale, depthScale - 0.5 / vec2(textureSize(depth, 0)));
+    float sceneDepth = texture(depth, depthCoords).r;
+
+    // back to world space and into the camera the history was made with
+    vec4 world = inverseViewProjection * vec4(vec3(TexCoords, sceneDepth) * 2.0 - 1.0, 1.0);
+    world /= world.w;
+    float viewDepth = (viewProjection * world).w;
+    vec4 previousClip = historyViewProjection * world;
+    vec2 previousCoords = previousClip.xy / previousClip.w * 0.5 + 0.5;
+
+    // disocclusion: the history pixel was made for a surface at another depth, or is off screen
+    vec4 previous = texture(history, previousCoords);
+    bool onScreen = all(greaterThanEqual(previousCoords, vec2(0.0))) && all(lessThanEqual(previousCoords, vec2(1.0)));
+    bool valid = onScreen && previousClip.w > 0.0 && abs(previous.a - previousClip.w) < depthTolerance * previousClip.w;
+
+    vec3 result;
+    if (updated)
+        result = valid ? mix(texture(current, TexCoords).rgb, previous.rgb, historyWeight) : texture(current, TexCoords).rgb;
+    else
+        result = valid ? previous.rgb : texture(history, TexCoords).rgb; // nothing newer, keep what was there
+
+    FragColor = vec4(result, viewDepth);
+}
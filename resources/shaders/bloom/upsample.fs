@@ -0,0 +1,24 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform float radius;
+
+// 3x3 tent filter, blended additively onto the next bigger level
+void main() {
+    vec2 d = radius / vec2(textureSize(source, 0));
+
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += (texture(source, TexCoords + vec2(-d.x, 0.0)).rgb
+             + texture(source, TexCoords + vec2( d.x, 0.0)).rgb
+             + texture(source, TexCoords + vec2(0.0, -d.y)).rgb
+             + texture(source, TexCoords + vec2(0.0,  d.y)).rgb) * 2.0;
+    result += texture(source, TexCoords + vec2(-d.x, -d.y)).rgb
+            + texture(source, TexCoords + vec2( d.x, -d.y)).rgb
+            + texture(source, TexCoords + vec2(-d.x,  d.y)).rgb
+            + texture(source, TexCoords + vec2( d.x,  d.y)).rgb;
+
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -0,0 +1,50 @@
+#version 430 core
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout (binding = 0) uniform sampler2D image;
+// no format qualifier, a write only image takes the format of the bound texture
+layout (binding = 0) uniform writeonly image2D result;
+
+#define TILE 16
+#define RADIUS 4
+#define APRON (TILE + 2 * RADIUS)
+
+const float weight[RADIUS + 1] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
+
+shared vec3 tile[APRON][APRON];
+shared vec3 rows[APRON][TILE];
+
+// One dispatch is a horizontal and a vertical pass of the 9 tap gaussian: the group reads its
+// 16x16 tile plus a 4 texel apron from the texture once, blurs the rows (apron rows included)
+// in shared memory and then the columns, and writes the tile out once.
+void main() {
+    ivec2 size = textureSize(image, 0);
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * TILE - RADIUS;
+    uint thread = gl_LocalInvocationIndex;
+
+    for (uint i = thread; i < APRON * APRON; i += TILE * TILE) {
+        ivec2 local = ivec2(i % APRON, i / APRON);
+        ivec2 texel = clamp(origin + local, ivec2(0), size - 1);
+        tile[local.y][local.x] = texelFetch(image, texel, 0).rgb;
+    }
+    barrier();
+
+    for (uint i = thread; i < APRON * TILE; i += TILE * TILE) {
+        int x = int(i % TILE);
+        int y = int(i / TILE);
+        vec3 sum = tile[y][x + RADIUS] * weight[0];
+        for (int k = 1; k <= RADIUS; k++)
+            sum += (tile[y][x + RADIUS - k] + tile[y][x + RADIUS + k]) * weight[k];
+        rows[y][x] = sum;
+    }
+    barrier();
+
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    vec3 sum = rows[local.y + RADIUS][local.x] * weight[0];
+    for (int k = 1; k <= RADIUS; k++)
+        sum += (rows[local.y + RADIUS - k][local.x] + rows[local.y + RADIUS + k][local.x]) * weight[k];
+
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(texel, size)))
+        imageStore(result, texel, vec4(sum, 1.0));
+}
@@ -1,9 +1,14 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+// object motion in uv, only stored when the scene target has a velocity attachment
+layout (location = 1) out vec4 Velocity;
 
 in vec3 Normal;
 in vec3 Position;
 
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+
 uniform vec3 cameraPos;
 uniform samplerCube skybox;
 
@@ -11,4 +16,5 @@ void main() {
     vec3 I = normalize(Position - cameraPos);
     vec3 R = reflect(I, normalize(Normal));
     FragColor = vec4(texture(skybox, R).rgb, 1.0);
+    Velocity = vec4((CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5, 0.0, 1.0);
 }
\ No newline at end of file
@@ -4,13 +4,26 @@ layout (location = 1) in vec3 aNormal;
 
 out vec3 Normal;
 out vec3 Position;
+// object motion for the temporal upsampler, both in the previous camera so its own motion cancels out
+out vec4 CurrentClip;
+out vec4 PreviousClip;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+    mat4 skyboxView;
+    mat4 previousViewProjection;  // unjittered
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 previousModel;
+};
 
 void main() {
     Normal = mat3(transpose(inverse(model))) * aNormal;
     Position = vec3(model * vec4(aPos, 1.0));
     gl_Position = projection * view * model * vec4(aPos, 1.0);
+    CurrentClip = previousViewProjection * model * vec4(aPos, 1.0);
+    PreviousClip = previousViewProjection * previousModel * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 330 core
+// G-buffer, the reflection is final so it goes in as the albedo of an unlit material
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gMaterial;
+layout (location = 3) out vec4 Velocity;
+
+in vec3 Normal;
+in vec3 Position;
+
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+
+uniform vec3 cameraPos;
+uniform samplerCube skybox;
+
+void main() {
+    vec3 I = normalize(Position - cameraPos);
+    vec3 R = reflect(I, normalize(Normal));
+    gAlbedo = vec4(texture(skybox, R).rgb, 1.0);
+    gNormal = vec4(0.0, 0.0, 0.0, 1.0);
+    gMaterial = vec4(0.0);
+    Velocity = vec4((CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5, 0.0, 1.0);
+}
@@ -0,0 +1,198 @@
+#version 330 core
+// one full screen pass over the G-buffer, the same terms as planet.fs but once per pixel
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 Velocity;
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+    // fades the light out towards the range its clusters were culled with
+    float range;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// what the surface of a pixel needs from the G-buffer
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float specular;
+    float shininess;
+};
+
+const int MATERIAL_COUNT = 5;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gMaterial;
+uniform sampler2D gVelocity;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform vec2 viewportSize;
+uniform vec3 viewPos;
+
+// the direction is shared, the colors are per material, index 0 is unlit
+uniform vec3 dirLightDirection;
+uniform vec3 dirLightSpecular;
+uniform vec3 dirLightAmbient[MATERIAL_COUNT];
+uniform vec3 dirLightDiffuse[MATERIAL_COUNT];
+uniform SpotLight spotLight;
+
+// clustered point lights, see ClusteredLights.h
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec2 clusterScale;
+uniform vec2 depthRange;
+uniform float sliceScale;
+
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24);
+
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+// first light index and light count of the cluster of a pixel, from the depth the G-buffer stored
+uvec2 lightCluster(float depth) {
+    float z = depth * 2.0 - 1.0;
+    float viewDepth = 2.0 * depthRange.x * depthRange.y / (depthRange.y + depthRange.x - z * (depthRange.y - depthRange.x));
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * clusterScale), int(log(viewDepth / depthRange.x) * sliceScale));
+    cluster = clamp(cluster, ivec3(0), CLUSTER_GRID - 1);
+    return texelFetch(lightGrid, (cluster.z * CLUSTER_GRID.y + cluster.y) * CLUSTER_GRID.x + cluster.x).xy;
+}
+
+PointLight fetchLight(int index) {
+    vec4 positionRange = texelFetch(lightData, index * 4);
+    vec4 ambientConstant = texelFetch(lightData, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(lightData, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(lightData, index * 4 + 3);
+
+    PointLight light;
+    light.position = positionRange.xyz;
+    light.range = positionRange.w;
+    light.ambient = ambientConstant.xyz;
+    light.constant = ambientConstant.w;
+    light.diffuse = diffuseLinear.xyz;
+    light.linear = diffuseLinear.w;
+    light.specular = specularQuadratic.xyz;
+    light.quadratic = specularQuadratic.w;
+    return light;
+}
+
+vec3 CalcDirLight(int materialIndex, Surface surface, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 viewDir);
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 viewDir);
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    vec4 material = texelFetch(gMaterial, pixel, 0);
+    int materialIndex = int(material.b * 255.0 + 0.5);
+    Velocity = texelFetch(gVelocity, pixel, 0);
+
+    // nothing drawn, the sky goes over it; unlit surfaces keep their color
+    if (depth == 1.0 || materialIndex == 0) {
+        FragColor = vec4(albedo.rgb, 1.0);
+        return;
+    }
+
+    vec4 world = inverseViewProjection * vec4(vec3(gl_FragCoord.xy / viewportSize, depth) * 2.0 - 1.0, 1.0);
+    Surface surface;
+    surface.position = world.xyz / world.w;
+    surface.normal = decodeNormal(texelFetch(gNormal, pixel, 0).xy);
+    surface.albedo = albedo.rgb;
+    surface.specular = material.r;
+    surface.shininess = material.g * 256.0;
+    vec3 viewDir = normalize(viewPos - surface.position);
+
+    vec3 result = CalcDirLight(materialIndex, surface, viewDir);
+
+    uvec2 cluster = lightCluster(depth);
+    for (uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(fetchLight(int(texelFetch(lightIndices, int(cluster.x + i)).r)), surface, viewDir);
+
+    result += CalcSpotLight(spotLight, surface, viewDir);
+
+    FragColor = vec4(result, 1.0);
+}
+
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 viewDir) {
+    vec3 lightDir = normalize(light.position - surface.position);
+    // diffuse shading
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    // attenuation
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float falloff = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+    // combine results
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specular;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcDirLight(int materialIndex, Surface surface, vec3 viewDir) {
+    vec3 lightDir = normalize(-dirLightDirection);
+    // diffuse shading
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    // combine results
+    vec3 ambient = dirLightAmbient[materialIndex] * surface.albedo;
+    vec3 diffuse = dirLightDiffuse[materialIndex] * diff * surface.albedo;
+    vec3 specular = dirLightSpecular * spec * surface.specular;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 viewDir) {
+    vec3 lightDir = normalize(light.position - surface.position);
+    // diffuse shading
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    // attenuation
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specular;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
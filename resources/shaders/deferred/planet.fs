@@ -0,0 +1,40 @@
+#version 330 core
+// G-buffer, see the deferred lighting pass in main.cpp
+layout (location = 0) out vec4 gAlbedo;    // diffuse texture
+layout (location = 1) out vec4 gNormal;    // octahedral
+layout (location = 2) out vec4 gMaterial;  // specular texture, shininess / 256, material index / 255
+// object motion in uv, only stored when the G-buffer has a velocity attachment
+layout (location = 3) out vec4 Velocity;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    float shininess;
+};
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+
+uniform Material material;
+// picks the directional light of the object in the lighting pass, 0 is unlit
+uniform int materialIndex;
+
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) {
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return e;
+}
+
+void main() {
+    gAlbedo = vec4(texture(material.texture_diffuse1, TexCoords).rgb, 1.0);
+    gNormal = vec4(encodeNormal(normalize(Normal)), 0.0, 1.0);
+    gMaterial = vec4(texture(material.texture_specular1, TexCoords).r, material.shininess / 256.0, float(materialIndex) / 255.0, 1.0);
+    Velocity = vec4((CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5, 0.0, 1.0);
+}
@@ -1,9 +1,8 @@
 #version 330 core
 
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
-
-#define NR_POINT_LIGHTS 4
+// object motion in uv, only stored when the scene target has a velocity attachment
+layout (location = 1) out vec4 Velocity;
 
 struct PointLight {
     vec3 position;
@@ -15,6 +14,8 @@ struct PointLight {
     float constant;
     float linear;
     float quadratic;
+    // fades the light out towards the range its clusters were culled with
+    float range;
 };
 
 struct DirLight {
@@ -50,14 +51,53 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+
 uniform vec3 viewPos;
 uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform SpotLight spotLight;
 uniform Material material;
 
+// clustered point lights, see ClusteredLights.h
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec2 clusterScale;
+uniform vec2 depthRange;
+uniform float sliceScale;
+
 uniform float diamondTransparent;
 
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24);
+
+// first light index and light count of the cluster this fragment is in
+uvec2 lightCluster() {
+    float z = gl_FragCoord.z * 2.0 - 1.0;
+    float viewDepth = 2.0 * depthRange.x * depthRange.y / (depthRange.y + depthRange.x - z * (depthRange.y - depthRange.x));
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * clusterScale), int(log(viewDepth / depthRange.x) * sliceScale));
+    cluster = clamp(cluster, ivec3(0), CLUSTER_GRID - 1);
+    return texelFetch(lightGrid, (cluster.z * CLUSTER_GRID.y + cluster.y) * CLUSTER_GRID.x + cluster.x).xy;
+}
+
+PointLight fetchLight(int index) {
+    vec4 positionRange = texelFetch(lightData, index * 4);
+    vec4 ambientConstant = texelFetch(lightData, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(lightData, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(lightData, index * 4 + 3);
+
+    PointLight light;
+    light.position = positionRange.xyz;
+    light.range = positionRange.w;
+    light.ambient = ambientConstant.xyz;
+    light.constant = ambientConstant.w;
+    light.diffuse = diffuseLinear.xyz;
+    light.linear = diffuseLinear.w;
+    light.specular = specularQuadratic.xyz;
+    light.quadratic = specularQuadratic.w;
+    return light;
+}
+
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -69,22 +109,16 @@ void main() {
 
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
     // phase 2: point lights
-     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-            result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    uvec2 cluster = lightCluster();
+    for (uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(fetchLight(int(texelFetch(lightIndices, int(cluster.x + i)).r)), norm, FragPos, viewDir);
     // phase 3: spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
 
     vec4 texColor = vec4(result, 1.0);
     texColor.a = diamondTransparent;
     FragColor = texColor;
-
-    float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-
-    if (brightness > 1.0) {
-        BrightColor = FragColor;
-    } else {
-        BrightColor = vec4(.0f, .0f, .0f, 1.0);
-    }
+    Velocity = vec4((CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5, 0.0, 1.0);
 }
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
@@ -97,6 +131,8 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float falloff = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
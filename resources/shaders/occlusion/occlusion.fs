@@ -0,0 +1,7 @@
+#version 330 core
+out vec4 FragColor;
+
+// only depth testing matters, color writes are masked off while the boxes are drawn
+void main() {
+    FragColor = vec4(1.0);
+}
@@ -1,19 +1,46 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;     // quantised inside the mesh bounds
+layout (location = 1) in vec2 aNormal;  // octahedral
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
+// object motion for the temporal upsampler, both in the previous camera so its own motion cancels out
+out vec4 CurrentClip;
+out vec4 PreviousClip;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+    mat4 skyboxView;
+    mat4 previousViewProjection;  // unjittered
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 previousModel;
+};
+
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
 
 void main() {
+    vec3 position = positionOffset + aPos.xyz * positionScale;
+    vec3 normal = decodeNormal(aNormal);
+
     TexCoords = aTexCoords;
-    Normal = aNormal;
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    Normal = normal;
+    FragPos = vec3(model * vec4(position, 1.0));
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    CurrentClip = previousViewProjection * model * vec4(position, 1.0);
+    PreviousClip = previousViewProjection * previousModel * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+#version 330 core
+// permutations: BLOOM, FXAA, VIGNETTE, GAMMA, TRANSPARENCY are defined by PostProcess for the enabled effects
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform sampler2D bloomBlur;
+uniform float bloomStrength;
+uniform float exposure;
+uniform float gamma;
+uniform float vignetteStrength;
+// part of the scene texture covered by the scaled viewport, the bloom always covers all of its own
+uniform vec2 sceneScale;
+// one output pixel in uv
+uniform vec2 texelSize;
+
+#ifdef TRANSPARENCY
+// half resolution layer: premultiplied color and the transmittance left for the scene behind it
+uniform sampler2D transparency;
+// the downsampled scene depth the layer was tested against, and the full resolution one
+uniform sampler2D transparencyDepth;
+uniform sampler2D sceneDepth;
+// part of the layer and depth textures covered by the scaled viewport, the scene may be upsampled already
+uniform vec2 layerScale;
+// near and far plane
+uniform vec2 depthRange;
+
+float linearDepth(float depth) {
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * depthRange.x * depthRange.y / (depthRange.y + depthRange.x - z * (depthRange.y - depthRange.x));
+}
+
+// bilateral upsample: bilinear weights of the four layer texels around the pixel, scaled down by how far
+// their depth is from the pixel's own, so the layer does not bleed across silhouettes
+vec4 upsampleTransparency(vec2 uv) {
+    vec2 sceneCoords = min(uv * layerScale, layerScale - 0.5 / vec2(textureSize(sceneDepth, 0)));
+    vec2 size = vec2(textureSize(transparency, 0));
+    ivec2 lastTexel = ivec2(ceil(layerScale * size)) - 1;
+    vec2 position = sceneCoords * size - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = fract(position);
+    float depth = linearDepth(texture(sceneDepth, sceneCoords).r);
+
+    vec4 sum = vec4(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), lastTexel);
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float difference = abs(linearDepth(texelFetch(transparencyDepth, texel, 0).r) - depth) / depth;
+        float weight = bilinear.x * bilinear.y / (0.001 + difference);
+        sum += texelFetch(transparency, texel, 0) * weight;
+        total += weight;
+    }
+    return total > 0.0 ? sum / total : vec4(0.0, 0.0, 0.0, 1.0);
+}
+#endif
+
+// scene and bloom at uv, tonemapped and gamma corrected
+vec3 resolve(vec2 uv) {
+    // stop half a texel short of the edge, past it is whatever an earlier, larger frame left there
+    vec2 sceneCoords = min(uv * sceneScale, sceneScale - 0.5 / vec2(textureSize(scene, 0)));
+    vec3 hdrColor = texture(scene, sceneCoords).rgb;
+#ifdef TRANSPARENCY
+    vec4 layer = upsampleTransparency(uv);
+    hdrColor = hdrColor * layer.a + layer.rgb;
+#endif
+#ifdef BLOOM
+    hdrColor += texture(bloomBlur, uv).rgb * bloomStrength; // additive blending
+#endif
+
+    // tone mapping
+    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+#ifdef GAMMA
+    result = pow(result, vec3(1.0 / gamma));
+#endif
+    return result;
+}
+
+#ifdef FXAA
+float luma(vec3 color) {
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+// FXAA (Lottes) on the resolved colour: find the edge direction from the four diagonal
+// neighbours and blend along it, unless the blend overshoots the local contrast range
+vec3 fxaa(vec2 uv) {
+    const float REDUCE_MIN = 1.0 / 128.0;
+    const float REDUCE_MUL = 1.0 / 8.0;
+    const float SPAN_MAX = 8.0;
+
+    vec3 rgbM = resolve(uv);
+    float lumaNW = luma(resolve(uv + vec2(-1.0, -1.0) * texelSize));
+    float lumaNE = luma(resolve(uv + vec2( 1.0, -1.0) * texelSize));
+    float lumaSW = luma(resolve(uv + vec2(-1.0,  1.0) * texelSize));
+    float lumaSE = luma(resolve(uv + vec2( 1.0,  1.0) * texelSize));
+    float lumaM = luma(rgbM);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(0.0312, lumaMax * 0.125))
+        return rgbM;
+
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * REDUCE_MUL), REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, -SPAN_MAX, SPAN_MAX) * texelSize;
+
+    vec3 rgbA = 0.5 * (resolve(uv + dir * (1.0 / 3.0 - 0.5)) + resolve(uv + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (resolve(uv - dir * 0.5) + resolve(uv + dir * 0.5));
+    float lumaB = luma(rgbB);
+    return (lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB;
+}
+#endif
+
+void main() {
+#ifdef FXAA
+    vec3 result = fxaa(TexCoords);
+#else
+    vec3 result = resolve(TexCoords);
+#endif
+
+#ifdef VIGNETTE
+    vec2 centered = TexCoords - 0.5;
+    result *= mix(1.0, smoothstep(0.8, 0.25, length(centered)), vignetteStrength);
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+
+out vec2 TexCoords;
+
+// one triangle over the whole screen, drawn without a vertex buffer: no diagonal seam and no
+// 2x2 quads wasted on it, the parts outside the screen are clipped
+void main() {
+    TexCoords = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+}
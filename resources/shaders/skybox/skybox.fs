@@ -1,5 +1,7 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+// the sky only moves with the camera, which the temporal upsampler reprojects from depth
+layout (location = 1) out vec4 Velocity;
 
 in vec3 TexCoords;
 
@@ -7,4 +9,5 @@ uniform samplerCube skybox;
 
 void main() {
     FragColor = texture(skybox, TexCoords);
+    Velocity = vec4(0.0, 0.0, 0.0, 1.0);
 }
\ No newline at end of file
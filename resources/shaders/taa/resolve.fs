@@ -0,0 +1,64 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+// object motion in uv, camera motion is left out
+uniform sampler2D velocity;
+uniform sampler2D depth;
+uniform sampler2D history;
+// part of the scene textures covered by the scaled viewport
+uniform vec2 sceneScale;
+// jitter of this frame in scene uv
+uniform vec2 jitter;
+// camera of this frame and of the history, both without jitter
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+uniform float feedback;
+// the history is garbage, take the new sample as it is
+uniform bool reset;
+
+float luma(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main() {
+    // the scene sample for this output pixel, without the jitter
+    vec2 sceneSize = vec2(textureSize(scene, 0));
+    vec2 sceneCoords = min(TexCoords * sceneScale + jitter, sceneScale - 0.5 / sceneSize);
+    vec3 current = texture(scene, sceneCoords).rgb;
+    if (reset) {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    // colour range of the 3x3 scene pixels around it
+    ivec2 center = ivec2(sceneCoords * sceneSize);
+    ivec2 lastTexel = ivec2(sceneScale * sceneSize) - 1;
+    vec3 low = current;
+    vec3 high = current;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 neighbour = texelFetch(scene, clamp(center + ivec2(x, y), ivec2(0), lastTexel), 0).rgb;
+            low = min(low, neighbour);
+            high = max(high, neighbour);
+        }
+    }
+
+    // where the pixel was: the camera motion from the depth, then the object's own
+    float sceneDepth = texture(depth, sceneCoords).r;
+    vec4 world = inverseViewProjection * vec4(vec3(TexCoords, sceneDepth) * 2.0 - 1.0, 1.0);
+    vec4 previousClip = previousViewProjection * (world / world.w);
+    vec2 previousCoords = previousClip.xy / previousClip.w * 0.5 + 0.5 - texture(velocity, sceneCoords).xy;
+    if (any(lessThan(previousCoords, vec2(0.0))) || any(greaterThan(previousCoords, vec2(1.0)))) {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+    vec3 previous = clamp(texture(history, previousCoords).rgb, low, high);
+
+    // weights shrunk by brightness, so a single bright sample does not flicker
+    float currentWeight = (1.0 - feedback) / (1.0 + luma(current));
+    float historyWeight = feedback / (1.0 + luma(previous));
+    FragColor = vec4((current * currentWeight + previous * historyWeight) / (currentWeight + historyWeight), 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+in vec2 TexCoords;
+
+uniform sampler2D depth;
+// last texel of the scaled viewport in the full resolution depth
+uniform vec2 lastTexel;
+
+// farthest of the 2x2 full resolution texels under this pixel, so transparent surfaces behind a
+// silhouette are still shaded and the upsample can choose between the layers per full resolution pixel
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = ivec2(lastTexel);
+    float d = max(max(texelFetch(depth, min(texel, last), 0).r,
+                      texelFetch(depth, min(texel + ivec2(1, 0), last), 0).r),
+                  max(texelFetch(depth, min(texel + ivec2(0, 1), last), 0).r,
+                      texelFetch(depth, min(texel + ivec2(1, 1), last), 0).r));
+    gl_FragDepth = d;
+}
@@ -1,12 +1,18 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+// object motion in uv, only stored when the scene target has a velocity attachment
+layout (location = 1) out vec4 Velocity;
 
 in vec2 TexCoords;
 
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+
 uniform sampler2D texture1;
 
 void main() {
     vec4 texColor = texture(texture1, TexCoords);
     if (texColor.a < 0.3) discard;
     FragColor = texColor;
+    Velocity = vec4((CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5, 0.0, 1.0);
 }
\ No newline at end of file
@@ -3,12 +3,25 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
+// object motion for the temporal upsampler, both in the previous camera so its own motion cancels out
+out vec4 CurrentClip;
+out vec4 PreviousClip;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+    mat4 skyboxView;
+    mat4 previousViewProjection;  // unjittered
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 previousModel;
+};
 
 void main() {
     TexCoords = aTexCoords;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
+    CurrentClip = previousViewProjection * model * vec4(aPos, 1.0);
+    PreviousClip = previousViewProjection * previousModel * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -11,6 +11,21 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <rg/Frustum.h>
+#include <rg/BVH.h>
+#include <rg/GLCaps.h>
+#include <rg/OcclusionCuller.h>
+#include <rg/RingBuffer.h>
+#include <rg/ComputeShader.h>
+#include <rg/RenderTargetPool.h>
+#include <rg/Bloom.h>
+#include <rg/DynamicResolution.h>
+#include <rg/PostProcess.h>
+#include <rg/GpuTimer.h>
+#include <rg/RenderGraph.h>
+#include <rg/TemporalAA.h>
+#include <rg/ClusteredLights.h>
+#include <rg/LightSystem.h>
 #include <iostream>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -18,7 +33,11 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadCubemap(std::vector<std::string> faces);
-void drawModel(Model obj_model, Shader shader, const std::vector<glm::vec3>& translations, glm::vec3 rotation, glm::vec3 scale, glm::mat4 projection, glm::mat4 view);
+glm::mat4 modelMatrix(const std::vector<glm::vec3>& translations, glm::vec3 rotation, glm::vec3 scale, float angle);
+void drawModel(Model &obj_model, Shader &shader, const glm::mat4 &model, const glm::mat4 &previousModel, glm::mat4 projection);
+void setModelMatrix(const glm::mat4 &model);
+void setModelMatrix(const glm::mat4 &model, const glm::mat4 &previousModel);
+void bindUniformBlocks(const Shader &objShader);
 void loadFaces(std::vector<std::string> &faces, const std::string& dirName);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 unsigned int loadTexture(char const * path);
@@ -29,10 +48,34 @@ void renderQuad();
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// clip planes of the camera, the occlusion culling, the transparency depth and the light clusters use the same
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 bool bloom = false;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+// scene and bloom targets, nothing after the scene pass reads alpha so 4 bytes per pixel are enough
+GLenum hdrFormat = GL_R11F_G11F_B10F;
+
+// FXAA runs inside the post pass on the tonemapped image, MSAA renders the scene into a
+// multisampled target and resolves it with a blit, TAA renders it jittered at reduced resolution
+// and upsamples it with the history of the previous frames
+enum AntiAliasing { AA_OFF, AA_FXAA, AA_MSAA_4X, AA_TAA };
+AntiAliasing antiAliasing = AA_FXAA;
+
+// the diamond and the windows are shaded into a half resolution layer that the post pass
+// composites over the scene, instead of inside the scene pass
+bool halfResTransparency = false;
+
+// the cube and the planets are written into a G-buffer and lit in one screen space pass, so the
+// light loop runs once per pixel instead of once per drawn fragment; the transparent geometry and
+// the sky are drawn forward over the result. MSAA keeps the forward path, the G-buffer is single sampled
+bool deferredShading = false;
+
+// size of the default framebuffer in pixels, differs from the window size on high dpi screens
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 // camera
 float lastX = SCR_WIDTH / 2.0f;
@@ -78,8 +121,62 @@ struct SpotLight {
     glm::vec3 specular;
 };
 
+// uniform buffer binding points shared by all shaders
+enum UniformBlock {
+    MATRICES_BLOCK,
+    OBJECT_BLOCK
+};
+
+// layout of the std140 Matrices block
+struct FrameMatrices {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 skyboxView;
+    glm::mat4 previousViewProjection;
+};
+
+// layout of the std140 Object block, the previous model matrix gives the motion of the object
+struct ObjectMatrices {
+    glm::mat4 model;
+    glm::mat4 previousModel;
+};
+
+// everything registered in the scene tree
+namespace SceneObject {
+enum Id {
+    CUBE,
+    DIAMOND,
+    MARS,
+    VENUS,
+    SUN,
+    WINDOW_FIRST,
+    COUNT = WINDOW_FIRST + 6
+};
+}
+
 void setDiamondLightsShader(Shader objShader, PointLight pointLight, DirLight dirLight, SpotLight spotLight);
 void setLightsShader(Shader objShader, PointLight pointLight, DirLight dirLight, SpotLight spotLight, glm::vec3 dirLightDiffuse, glm::vec3 dirLightAmbient);
+void setDeferredLightingShader(Shader &objShader, const glm::mat4 &inverseViewProjection, glm::ivec2 viewportSize);
+void initPointLights();
+void updatePointLights(float time, const glm::mat4 &view, const glm::mat4 &projection);
+void setExtraLightCount(int count);
+
+// texture units of the clustered light buffers, above the material textures
+const int LIGHT_BUFFER_UNIT = 8;
+// the first point lights are the ones of the scene, the rest are added from the settings window
+const int SCENE_POINT_LIGHTS = 4;
+// the extra lights fade out within this distance, so each one only lands in the clusters around it
+const float EXTRA_LIGHT_RADIUS = 2.0f;
+
+// directional light of each planet, venus glows red. The G-buffer stores the scene object as the
+// material index, the deferred lighting pass picks the colors with it; the cube is 0, unlit
+const int DEFERRED_MATERIALS = SceneObject::SUN + 1;
+const glm::vec3 PLANET_DIR_LIGHT_DIFFUSE[DEFERRED_MATERIALS] = {
+        glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.4f), glm::vec3(2.4f, 0.4f, 0.4f), glm::vec3(0.4f)
+};
+const glm::vec3 PLANET_DIR_LIGHT_AMBIENT[DEFERRED_MATERIALS] = {
+        glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.05f), glm::vec3(0.6f, 0.05f, 0.05f), glm::vec3(0.05f)
+};
 
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(.1f, .1f, .1f);
@@ -98,6 +195,48 @@ struct ProgramState {
     DirLight dirLight;
     SpotLight spotLight, cubeSpotLight;
 
+    // view frustum of the current frame and how many meshes it let through
+    Frustum frustum;
+    unsigned int meshesDrawn = 0;
+    unsigned int meshesCulled = 0;
+    unsigned int trianglesDrawn = 0;
+
+    // bounds of every scene object, queried for visibility and proximity instead of testing objects one by one
+    DynamicBVH sceneTree;
+    int sceneProxies[SceneObject::COUNT];
+    bool objectVisible[SceneObject::COUNT];
+    std::vector<int> queryResult;
+
+    // hardware occlusion queries for the objects inside the cube
+    OcclusionCuller occlusion;
+
+    // uniform data that changes every frame or every draw
+    RingBuffer frameData;
+
+    // offscreen targets, reallocated when the framebuffer size changes
+    RenderTargetPool renderTargets;
+
+    // glow around the bright parts of the frame
+    Bloom bloomEffect;
+
+    // scene resolution picked from the GPU frame time
+    DynamicResolution dynamicResolution;
+
+    // composite, tonemapping and screen space effects in one pass
+    PostProcess postProcess;
+
+    // per pass GPU times for the settings window
+    GpuTimer gpuTimer;
+
+    // passes of a frame and the targets between them
+    RenderGraph renderGraph;
+
+    // temporal upsampler and what the last frame was drawn with, for the motion vectors
+    TemporalAA temporalAA;
+    glm::mat4 previousViewProjection;
+    glm::mat4 previousModels[SceneObject::COUNT];
+    bool hasPreviousFrame = false;
+
     ProgramState() : camera(glm::vec3(0.0f, 0.0f, 7.0f)),
                     diamond(FileSystem::getPath("resources/objects/diamond/Diamond.obj")),
                     pink_diamond(FileSystem::getPath("resources/objects/pink_diamond/Diamond.obj")),
@@ -110,12 +249,10 @@ struct ProgramState {
 
     std::string color;
 
-    std::vector<glm::vec3> pointLightsPositions = {
-            glm::vec3( 0.7f,  0.2f,  2.0f),
-            glm::vec3( 2.3f, -3.3f, -4.0f),
-            glm::vec3(-4.0f,  2.0f, -12.0f),
-            glm::vec3( 0.0f,  0.0f, -3.0f)
-    };
+    // SCENE_POINT_LIGHTS lights of the scene followed by any number of extra lights, animated once per
+    // frame and sorted into the clusters of the view; the diamond and the planets share them
+    LightSystem pointLights;
+    ClusteredLights lightClusters;
 
     void SaveToFile(const std::string& filename) const;
     void LoadFromFile(const std::string& filename);
@@ -167,16 +304,27 @@ void ProgramState::LoadFromFile(const std::string& filename) {
 
 struct ProgramShader {
 
-    Shader cube, skybox, diamond, window, planet, hdr, bloom, blur;
+    Shader cube, skybox, diamond, window, planet, blur, occlusion, brightPass, downsample, upsample, temporalBloom, depthDownsample,
+           taaResolve, gbufferCube, gbufferPlanet, deferredLighting;
+    ComputeShader blurCompute;
 
     ProgramShader() : cube("resources/shaders/cube/cube.vs", "resources/shaders/cube/cube.fs"),
                     skybox("resources/shaders/skybox/skybox.vs", "resources/shaders/skybox/skybox.fs"),
                     diamond("resources/shaders/diamond/diamond.vs", "resources/shaders/diamond/diamond.fs"),
                     window("resources/shaders/window/transparent.vs", "resources/shaders/window/transparent.fs"),
                     planet("resources/shaders/planet/planet.vs", "resources/shaders/planet/planet.fs"),
-                    hdr("resources/shaders/hdr/hdr.vs", "resources/shaders/hdr/hdr.fs"),
-                    bloom("resources/shaders/bloom/bloom.vs", "resources/shaders/bloom/bloom.fs"),
-                    blur("resources/shaders/blur/blur.vs", "resources/shaders/blur/blur.fs") {}
+                    blur("resources/shaders/blur/blur.vs", "resources/shaders/blur/blur.fs"),
+                    occlusion("resources/shaders/occlusion/occlusion.vs", "resources/shaders/occlusion/occlusion.fs"),
+                    brightPass("resources/shaders/bloom/bloom.vs", "resources/shaders/bloom/brightpass.fs"),
+                    downsample("resources/shaders/bloom/bloom.vs", "resources/shaders/bloom/downsample.fs"),
+                    upsample("resources/shaders/bloom/bloom.vs", "resources/shaders/bloom/upsample.fs"),
+                    temporalBloom("resources/shaders/bloom/bloom.vs", "resources/shaders/bloom/temporal.fs"),
+                    depthDownsample("resources/shaders/bloom/bloom.vs", "resources/shaders/transparency/downsampledepth.fs"),
+                    taaResolve("resources/shaders/bloom/bloom.vs", "resources/shaders/taa/resolve.fs"),
+                    gbufferCube("resources/shaders/cube/cube.vs", "resources/shaders/deferred/cube.fs"),
+                    gbufferPlanet("resources/shaders/planet/planet.vs", "resources/shaders/deferred/planet.fs"),
+                    deferredLighting("resources/shaders/bloom/bloom.vs", "resources/shaders/deferred/lighting.fs"),
+                    blurCompute("resources/shaders/blur/blur.cs") {}
 
 };
 
@@ -205,6 +353,7 @@ int main() {
 
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
@@ -214,11 +363,29 @@ int main() {
         return -1;
     }
 
+    GLCaps::get().load((GLADloadproc) glfwGetProcAddress);
+
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
 
     shader = new ProgramShader;
 
+    // the models only get the vertex streams their shaders read
+    programState->diamond.Upload({&shader->diamond});
+    programState->pink_diamond.Upload({&shader->diamond});
+    programState->mars.Upload({&shader->planet, &shader->gbufferPlanet});
+    programState->venus.Upload({&shader->planet, &shader->gbufferPlanet});
+    programState->sun.Upload({&shader->planet, &shader->gbufferPlanet});
+
+    GLint uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    programState->frameData.init(GL_UNIFORM_BUFFER, 64 * 1024, uniformAlignment);
+
+    for (Shader *objShader : {&shader->cube, &shader->skybox, &shader->diamond, &shader->window, &shader->planet,
+                              &shader->gbufferCube, &shader->gbufferPlanet}) {
+        bindUniformBlocks(*objShader);
+    }
+
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     if (programState->ImGui2Enable) {
@@ -374,58 +541,31 @@ int main() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glBindVertexArray(0);
 
-    ////////////// HDR and BLOOM //////////////
-
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
+    // object space bounds of the cube and the window quad, used for frustum culling
+    AABB unitCube;
+    unitCube.min = glm::vec3(-0.5f);
+    unitCube.max = glm::vec3(0.5f);
 
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    AABB windowQuad;
+    windowQuad.min = glm::vec3(0.0f, -0.5f, 0.0f);
+    windowQuad.max = glm::vec3(1.0f, 0.5f, 0.0f);
 
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
+    ////////////// HDR and BLOOM //////////////
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // the HDR target and the bloom chain come from programState->renderTargets every frame,
+    // sized after the framebuffer; the bright parts are extracted by the bloom pass, so the scene
+    // only needs one color target
 
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
+    // bright pass and blur chain, both at reduced resolution
+    programState->bloomEffect.init(&programState->renderTargets, &shader->brightPass, &shader->downsample, &shader->upsample, &shader->blur,
+                                    &shader->blurCompute, &shader->temporalBloom, renderQuad);
 
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    programState->dynamicResolution.init();
+    programState->postProcess.init("resources/shaders/post/post.vs", "resources/shaders/post/post.fs");
+    programState->gpuTimer.init();
+    programState->renderGraph.init(&programState->renderTargets);
+    programState->temporalAA.init(&programState->renderTargets, &shader->taaResolve, renderQuad);
+    programState->lightClusters.init();
 
     /////////////// end HDR and BLOOM  ///////////////
 
@@ -437,6 +577,15 @@ int main() {
 
     shader->cube.use();
     shader->cube.setInt("skybox", 0);
+    shader->gbufferCube.use();
+    shader->gbufferCube.setInt("skybox", 0);
+
+    shader->deferredLighting.use();
+    shader->deferredLighting.setInt("gAlbedo", 0);
+    shader->deferredLighting.setInt("gNormal", 1);
+    shader->deferredLighting.setInt("gMaterial", 2);
+    shader->deferredLighting.setInt("gVelocity", 3);
+    shader->deferredLighting.setInt("gDepth", 4);
 
     shader->skybox.use();
     shader->skybox.setInt("skybox", 0);
@@ -446,16 +595,9 @@ int main() {
     shader->window.use();
     shader->window.setInt("texture1", 0);
 
-    shader->hdr.use();
-    shader->hdr.setInt("hdrBuffer", 0);
-
     shader->blur.use();
     shader->blur.setInt("image", 0);
 
-    shader->bloom.use();
-    shader->bloom.setInt("scene", 0);
-    shader->bloom.setInt("bloomBlur", 1);
-
     // hint: rotation -> glm::vec3(angle, axis, nothing)
     std::vector<std::map<std::string, glm::vec3>> windows = {
             {{"translation", glm::vec3(-8.45f, 0.0f, 8.6f)}, {"rotation", glm::vec3(0.0f, 0.0f, 0.0f)}}, // 1st window
@@ -466,6 +608,49 @@ int main() {
             {{"translation", glm::vec3(-8.45f, .0f, 8.6f)}, {"rotation", glm::vec3(90.0f, 1.0f, .0f)}} // 6th  window
     };
 
+    // the windows never move, so their model matrices are built once
+    std::vector<glm::mat4> windowModels;
+    for (auto &m : windows) {
+        glm::mat4 windowModel = glm::mat4(1.0f);
+        for (auto &p: m) {
+            if(p.first == "translation") {
+                windowModel = glm::translate(windowModel, p.second);
+            } else {
+                float angle = p.second.x;
+                float axis = p.second.y;
+                glm::vec3 rotateAxis;
+
+                if (axis == 1.0) {
+                    rotateAxis = glm::vec3(1.0f, .0f, .0f);
+                } else if (axis == 2.0) {
+                    rotateAxis = glm::vec3(.0f, 1.0f, .0f);
+                } else {
+                    rotateAxis = glm::vec3(.0f, .0f, 1.0f);
+                }
+
+                windowModel = glm::rotate(windowModel, glm::radians(angle), rotateAxis);
+            }
+        }
+
+        windowModel = glm::scale(windowModel, glm::vec3(16.9f, 16.9f, 0.0f));
+        windowModels.push_back(windowModel);
+    }
+
+    // scene tree, the static objects get their final bounds right away
+    glm::mat4 cubeModel = glm::scale(glm::mat4(1.0f), glm::vec3(17.0f, 17.0f, 17.0f));
+
+    for (int i = 0; i < SceneObject::COUNT; i++) {
+        AABB bounds = unitCube;
+        if (i == SceneObject::CUBE) {
+            bounds = unitCube.transformed(cubeModel);
+        } else if (i >= SceneObject::WINDOW_FIRST) {
+            bounds = windowQuad.transformed(windowModels[i - SceneObject::WINDOW_FIRST]);
+        }
+        programState->sceneProxies[i] = programState->sceneTree.createProxy(bounds, i);
+    }
+
+    programState->occlusion.init(SceneObject::COUNT, shader->occlusion.ID);
+
     programState->diamond.SetShaderTextureNamePrefix("material.");
     programState->mars.SetShaderTextureNamePrefix("material.");
     programState->venus.SetShaderTextureNamePrefix("material.");
@@ -477,6 +662,7 @@ int main() {
     programState->pointLight.constant = 1.0f;
     programState->pointLight.linear = 0.09f;
     programState->pointLight.quadratic = 0.032f;
+    initPointLights();
 
     programState->dirLight.direction = glm::vec3(-.8f, -.5f, -0.3f);
     programState->dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
@@ -505,56 +691,79 @@ int main() {
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // HDR
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f , 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
+        // a minimized window has no framebuffer to render into
+        if (framebufferWidth == 0 || framebufferHeight == 0) {
+            glfwPollEvents();
+            continue;
+        }
 
-        // cube
-        glm::mat4 cubeModel = glm::mat4(1.0f);
-        cubeModel = glm::scale(cubeModel, glm::vec3(17.0f, 17.0f, 17.0f));
-
-        shader->cube.use();
-        shader->cube.setMat4("projection", projection);
-        shader->cube.setMat4("view", view);
-        shader->cube.setMat4("model", cubeModel);
-        shader->cube.setVec3("cameraPos", programState->camera.Position);
-
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, programState->cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        double a = 17.02 * 0.5;
-
-        if (programState->camera.Position.x >= -a && programState->camera.Position.x <= a
-        && programState->camera.Position.y >= -a && programState->camera.Position.y <= a
-        && programState->camera.Position.z >= -a && programState->camera.Position.z <= a) {
-            drawImGui();
-            programState->inSpace = true;
-            programState->ImGui1Enable = false;
+        DynamicResolution &dynamicResolution = programState->dynamicResolution;
+        dynamicResolution.beginFrame();
+        GpuTimer &gpuTimer = programState->gpuTimer;
+        gpuTimer.beginFrame();
+        programState->renderTargets.beginFrame();
+
+        // the scene covers a scaled part of the full size targets, with TAA a smaller one still
+        bool taa = antiAliasing == AA_TAA;
+        TemporalAA &temporalAA = programState->temporalAA;
+        glm::ivec2 sceneSize = dynamicResolution.viewport(framebufferWidth, framebufferHeight);
+        if (taa) {
+            temporalAA.beginFrame();
+            sceneSize = glm::max(glm::ivec2(glm::vec2(sceneSize) * temporalAA.renderScale), glm::ivec2(1));
         } else {
-            programState->inSpace = false;
-//            programState->ImGui1Enable = true;
+            temporalAA.releaseHistory();
         }
+        glm::vec2 sceneScale = glm::vec2(sceneSize) / glm::vec2(framebufferWidth, framebufferHeight);
 
-        // MODELS
-        // diamonds models
+        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)framebufferWidth / (float)framebufferHeight, NEAR_PLANE, FAR_PLANE);
+        glm::mat4 view = programState->camera.GetViewMatrix();
+        if (!programState->hasPreviousFrame)
+            programState->previousViewProjection = projection * view;
+
+        // camera matrices for every shader, one upload per frame; only the rasterisation gets the jitter,
+        // culling and the motion vectors use the plain projection
+        RingBuffer &frameData = programState->frameData;
+        frameData.beginFrame();
+        FrameMatrices matrices = {taa ? temporalAA.jittered(projection, sceneSize) : projection, view, glm::mat4(glm::mat3(view)),
+                                  programState->previousViewProjection};
+        GLintptr matricesOffset = frameData.upload(&matrices, sizeof(matrices));
+        glBindBufferRange(GL_UNIFORM_BUFFER, MATRICES_BLOCK, frameData.buffer(), matricesOffset, sizeof(matrices));
+        // the half resolution transparency is composited after the TAA resolve, a jittered layer would shimmer
+        GLintptr unjitteredOffset = matricesOffset;
+        if (taa && halfResTransparency) {
+            FrameMatrices unjittered = matrices;
+            unjittered.projection = projection;
+            unjitteredOffset = frameData.upload(&unjittered, sizeof(unjittered));
+        }
 
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        programState->frustum = Frustum(projection * view);
+        programState->occlusion.setView(projection * view, programState->camera.Position, NEAR_PLANE);
+        programState->meshesDrawn = 0;
+        programState->meshesCulled = 0;
+        programState->trianglesDrawn = 0;
 
         double time = glfwGetTime();
 
-        glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f);
         glm::vec3 rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        glm::vec3 scale = glm::vec3(programState->diamondScale);
-
-        // turn on diamond
-
+        glm::vec3 planetScale = glm::vec3(0.08f, 0.08f, 0.08f);
+
+        Model &diamondModel = programState->color == "pink" ? programState->pink_diamond : programState->diamond;
+        glm::mat4 diamondMatrix = modelMatrix({glm::vec3(0.0f)}, rotation, glm::vec3(programState->diamondScale), time);
+        glm::mat4 marsMatrix = modelMatrix({glm::vec3(-2.f * cos(time), -2.0f * cos(time), -5.f * sin(time) / 2), glm::vec3(-0.4f, 1.0f, 0.0f)},
+                                           rotation, planetScale, time);
+        glm::mat4 venusMatrix = modelMatrix({glm::vec3(2.0f * cos(time), -2.0f * cos(time), 5.0f * sin(time) / 2), glm::vec3(-0.4f, 1.0f, 0.0f)},
+                                            rotation, planetScale, time);
+        glm::mat4 sunMatrix = modelMatrix({glm::vec3(0.f, 2.5f * cos(time) , -4.0f * sin(time) / 2), glm::vec3(0.1f, 0.5f, .0f)},
+                                          rotation, planetScale, time);
+
+        // refit the moving objects, only the ones that left their fat bounds get reinserted
+        DynamicBVH &sceneTree = programState->sceneTree;
+        sceneTree.moveProxy(programState->sceneProxies[SceneObject::DIAMOND], diamondModel.aabb.transformed(diamondMatrix));
+        sceneTree.moveProxy(programState->sceneProxies[SceneObject::MARS], programState->mars.aabb.transformed(marsMatrix));
+        sceneTree.moveProxy(programState->sceneProxies[SceneObject::VENUS], programState->venus.aabb.transformed(venusMatrix));
+        sceneTree.moveProxy(programState->sceneProxies[SceneObject::SUN], programState->sun.aabb.transformed(sunMatrix));
+
+        // turn on diamond, before the point lights are clustered
         if (programState->bling) {
             programState->dirLight.diffuse = glm::vec3(1.05f);
             programState->dirLight.specular = glm::vec3(1.05f);
@@ -571,125 +780,372 @@ int main() {
             programState->pointLight.specular = glm::vec3(0.0, 0.0, 0.0);
         }
 
-        setDiamondLightsShader(shader->diamond, programState->pointLight, programState->dirLight, programState->spotLight);
-
-        shader->diamond.use();
-        shader->diamond.setFloat("diamondTransparent", programState->diamondTransparent);
+        updatePointLights((float)time, view, projection);
 
-        if (programState->color == "clear") {
-            drawModel(programState->diamond, shader->diamond, {translation}, rotation, scale, projection, view);
-        } else if (programState->color == "pink") {
-            drawModel(programState->pink_diamond, shader->diamond, {translation}, rotation, scale, projection, view);
-        } else {
-            drawModel(programState->diamond, shader->diamond, {translation}, rotation, scale, projection, view);
+        // the objects did not move before the first frame
+        glm::mat4 *previousModels = programState->previousModels;
+        if (!programState->hasPreviousFrame) {
+            previousModels[SceneObject::DIAMOND] = diamondMatrix;
+            previousModels[SceneObject::MARS] = marsMatrix;
+            previousModels[SceneObject::VENUS] = venusMatrix;
+            previousModels[SceneObject::SUN] = sunMatrix;
         }
 
-        glDisable(GL_CULL_FACE);
-
-        // mars model
-        translation = glm::vec3(-2.f * cos(time), -2.0f * cos(time), -5.f * sin(time) / 2);
-        glm::vec3 translation2 = glm::vec3(-0.4f, 1.0f, 0.0f);
-        scale = glm::vec3(0.08f, 0.08f, 0.08f);
-
-        setLightsShader(shader->planet, programState->pointLight, programState->dirLight, programState->spotLight, glm::vec3(0.4f, 0.4f, 0.4f), glm::vec3(0.05f, 0.05f, 0.05f));
-
-        drawModel(programState->mars, shader->planet, {translation, translation2}, rotation, scale, projection, view);
-
-        // venus model
-        translation = glm::vec3(2.0f * cos(time), -2.0f * cos(time), 5.0f * sin(time) / 2);
-
-        setLightsShader(shader->planet, programState->pointLight, programState->dirLight, programState->spotLight, glm::vec3(2.4f, 0.4f, 0.4f), glm::vec3(0.6f, 0.05f, 0.05f));
+        sceneTree.queryFrustum(programState->frustum, programState->queryResult);
+        std::fill(programState->objectVisible, programState->objectVisible + SceneObject::COUNT, false);
+        for (int object : programState->queryResult) {
+            programState->objectVisible[object] = true;
+        }
 
-        drawModel(programState->venus, shader->planet, {translation, translation2}, rotation, scale, projection, view);
+        // the transparent geometry, drawn by the scene pass or the half resolution transparency pass
+        OcclusionCuller &occlusion = programState->occlusion;
+        auto drawDiamond = [&]() {
+            if (!programState->objectVisible[SceneObject::DIAMOND] || !occlusion.begin(SceneObject::DIAMOND, sceneTree.bounds(programState->sceneProxies[SceneObject::DIAMOND]))) {
+                programState->meshesCulled += diamondModel.meshes.size();
+                return;
+            }
+            setDiamondLightsShader(shader->diamond, programState->pointLight, programState->dirLight, programState->spotLight);
 
-        // sun model
-        translation = glm::vec3(0.f, 2.5f * cos(time) , -4.0f * sin(time) / 2);
-        translation2 = glm::vec3(0.1f, 0.5f, .0f);
+            shader->diamond.use();
+            shader->diamond.setFloat("diamondTransparent", programState->diamondTransparent);
 
-        setLightsShader(shader->planet, programState->pointLight, programState->dirLight, programState->spotLight, glm::vec3(0.4f, 0.4f, 0.4f), glm::vec3(0.05f, 0.05f, 0.05f));
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_BACK);
+            drawModel(diamondModel, shader->diamond, diamondMatrix, previousModels[SceneObject::DIAMOND], projection);
+            glDisable(GL_CULL_FACE);
+            occlusion.end(SceneObject::DIAMOND);
+        };
+        auto drawWindows = [&]() {
+            shader->window.use();
 
-        drawModel(programState->sun, shader->planet, {translation, translation2}, rotation, scale, projection, view);
+            glBindVertexArray(transparentVAO);
+            glBindTexture(GL_TEXTURE_2D, transparentTexture);
 
-        // transparent windows
+            for (unsigned int i = 0; i < windowModels.size(); i++) {
+                if (!programState->objectVisible[SceneObject::WINDOW_FIRST + i]) {
+                    continue;
+                }
+                setModelMatrix(windowModels[i]);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+        };
 
-        shader->window.use();
-        shader->window.setMat4("projection", projection);
-        shader->window.setMat4("view", view);
+        // the opaque geometry, shaded by the scene pass or written into the G-buffer
+        auto drawCube = [&](Shader &cubeShader) {
+            if (!programState->objectVisible[SceneObject::CUBE])
+                return;
+            cubeShader.use();
+            setModelMatrix(cubeModel);
+            cubeShader.setVec3("cameraPos", programState->camera.Position);
+
+            glBindVertexArray(cubeVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, programState->cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(0);
+        };
+        auto updateInSpace = [&]() {
+            sceneTree.querySphere(programState->camera.Position, 0.01f, programState->queryResult);
+
+            if (std::find(programState->queryResult.begin(), programState->queryResult.end(), SceneObject::CUBE) != programState->queryResult.end()) {
+                // only into the color, the velocity and G-buffer attachments keep what the geometry wrote
+                GLenum drawBuffers[1 + RenderTarget::MAX_EXTRA_ATTACHMENTS];
+                int drawBufferCount = 0;
+                for (; drawBufferCount < 1 + RenderTarget::MAX_EXTRA_ATTACHMENTS; drawBufferCount++) {
+                    GLint drawBuffer = GL_NONE;
+                    glGetIntegerv(GL_DRAW_BUFFER0 + drawBufferCount, &drawBuffer);
+                    if (drawBuffer == GL_NONE)
+                        break;
+                    drawBuffers[drawBufferCount] = (GLenum)drawBuffer;
+                }
+                glDrawBuffer(GL_COLOR_ATTACHMENT0);
+                drawImGui();
+                glDrawBuffers(drawBufferCount, drawBuffers);
+                programState->inSpace = true;
+                programState->ImGui1Enable = false;
+            } else {
+                programState->inSpace = false;
+    //            programState->ImGui1Enable = true;
+            }
+        };
+        auto drawPlanet = [&](SceneObject::Id object, Model &planet, const glm::mat4 &planetMatrix, bool gbuffer) {
+            if (!programState->objectVisible[object] || !occlusion.begin(object, sceneTree.bounds(programState->sceneProxies[object]))) {
+                programState->meshesCulled += planet.meshes.size();
+                return;
+            }
+            Shader &planetShader = gbuffer ? shader->gbufferPlanet : shader->planet;
+            if (gbuffer) {
+                planetShader.use();
+                planetShader.setInt("materialIndex", object);
+                planetShader.setFloat("material.shininess", 32.0f);
+            } else {
+                setLightsShader(planetShader, programState->pointLight, programState->dirLight, programState->spotLight,
+                                PLANET_DIR_LIGHT_DIFFUSE[object], PLANET_DIR_LIGHT_AMBIENT[object]);
+            }
 
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, transparentTexture);
+            drawModel(planet, planetShader, planetMatrix, previousModels[object], projection);
+            occlusion.end(object);
+        };
+        auto drawPlanets = [&](bool gbuffer) {
+            drawPlanet(SceneObject::MARS, programState->mars, marsMatrix, gbuffer);
+            drawPlanet(SceneObject::VENUS, programState->venus, venusMatrix, gbuffer);
+            drawPlanet(SceneObject::SUN, programState->sun, sunMatrix, gbuffer);
+        };
+        auto drawSky = [&]() {
+            // sunset skybox
+            drawSkyBox(shader->skybox, skyboxVAO, programState->cubemapTexture);
 
-        glm::mat4 windowModel;
-        float angle;
-        float axis;
-        glm::vec3 rotateAxis;
+            // Universe skybox
+            drawSkyBox(shader->skybox, skyboxVAO, programState->inner_cubemapTexture);
+        };
 
-        for (auto &m : windows) {
-            windowModel = glm::mat4(1.0f);
-            for (auto &p: m) {
-                if(p.first == "translation") {
-                    windowModel = glm::translate(windowModel, p.second);
-                } else {
-                    angle = p.second.x;
-                    axis = p.second.y;
-
-                    if (axis == 1.0) {
-                        rotateAxis = glm::vec3(1.0f, .0f, .0f);
-                    } else if (axis == 2.0) {
-                        rotateAxis = glm::vec3(.0f, 1.0f, .0f);
-                    } else {
-                        rotateAxis = glm::vec3(.0f, .0f, 1.0f);
-                    }
-
-                    windowModel = glm::rotate(windowModel, glm::radians(angle), rotateAxis);
+        // FRAME GRAPH
+        // scene (or gbuffer -> deferred lighting -> forward) -> (msaa resolve) -> (transparency) -> (taa upsample) -> bloom -> post -> imgui,
+        // bloom is culled when post does not read it
+        RenderGraph &graph = programState->renderGraph;
+        RenderTarget backbuffer;
+        backbuffer.width = framebufferWidth;
+        backbuffer.height = framebufferHeight;
+        RenderGraph::Resource screen = graph.importTarget("backbuffer", &backbuffer);
+
+        // HDR, with MSAA it is drawn into a multisampled target first, the single sampled one only gets the resolve
+        bool msaa = antiAliasing == AA_MSAA_4X;
+        bool deferred = deferredShading && !msaa;
+        RenderGraph::Resource sceneColor = -1;
+
+        // deferred: the G-buffer holds albedo, the octahedral normal, specular, shininess and material index,
+        // and the depth; the lighting pass shades every pixel once into the HDR target and copies the depth
+        // over, the scene pass then only draws the forward geometry into it
+        RenderGraph::Resource gbuffer = -1;
+        if (deferred) {
+            RenderGraph::Builder gbufferPass = graph.addPass("gbuffer", [&](const RenderGraph::Registry &registry) {
+                glBindFramebuffer(GL_FRAMEBUFFER, registry.target(gbuffer).fbo);
+                glViewport(0, 0, sceneSize.x, sceneSize.y);
+                // no motion and material 0 where nothing is drawn
+                glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+
+                // the outputs are stored as they are, their alpha is no blend factor
+                glDisable(GL_BLEND);
+                drawCube(shader->gbufferCube);
+                updateInSpace();
+                drawPlanets(true);
+                glEnable(GL_BLEND);
+            });
+            RenderGraph::TargetDesc gbufferDesc = {GL_RGBA8, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, 0,
+                                                   {GL_RG16F, GL_RGBA8, (GLenum)(taa ? GL_RG16F : 0)}};
+            gbuffer = gbufferPass.create("gbuffer", gbufferDesc);
+
+            RenderGraph::Builder lightingPass = graph.addPass("deferred lighting", [&](const RenderGraph::Registry &registry) {
+                RenderTarget &source = registry.target(gbuffer);
+                RenderTarget &target = registry.target(sceneColor);
+                glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+                glViewport(0, 0, sceneSize.x, sceneSize.y);
+
+                // positions come back with the jittered projection the G-buffer was drawn with
+                setDeferredLightingShader(shader->deferredLighting, glm::inverse(matrices.projection * view), sceneSize);
+                const unsigned int textures[] = {source.texture, source.extraTextures[0], source.extraTextures[1],
+                                                 source.extraTextures[2], source.depthTexture};
+                for (int i = 0; i < 5; i++) {
+                    glActiveTexture(GL_TEXTURE0 + i);
+                    glBindTexture(GL_TEXTURE_2D, textures[i]);
                 }
-            }
-
-            windowModel = glm::scale(windowModel, glm::vec3(16.9f, 16.9f, 0.0f));
-            shader->window.setMat4("model", windowModel);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+                glActiveTexture(GL_TEXTURE0);
+                glDisable(GL_DEPTH_TEST);
+                renderQuad();
+                glEnable(GL_DEPTH_TEST);
+
+                // the forward geometry is tested against the opaque depth
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.fbo);
+                glBlitFramebuffer(0, 0, sceneSize.x, sceneSize.y, 0, 0, sceneSize.x, sceneSize.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            });
+            lightingPass.read(gbuffer);
+            if (taa)
+                sceneColor = lightingPass.create("hdr + velocity", {hdrFormat, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, 0, {GL_RG16F}});
+            else
+                sceneColor = lightingPass.create("hdr", {hdrFormat, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, 0});
         }
 
-        // SKY_BOXES
-        // sunset skybox
-        drawSkyBox(shader->skybox, skyboxVAO, programState->cubemapTexture);
+        RenderGraph::Builder scenePass = graph.addPass(deferred ? "forward" : "scene", [&](const RenderGraph::Registry &registry) {
+            glBindFramebuffer(GL_FRAMEBUFFER, registry.target(sceneColor).fbo);
+            glViewport(0, 0, sceneSize.x, sceneSize.y);
+            if (!deferred) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                if (taa) {
+                    // no motion where nothing is drawn, the sky only moves with the camera
+                    const float noMotion[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                    glClearBufferfv(GL_COLOR, 1, noMotion);
+                }
 
-        // Universe skybox
-        drawSkyBox(shader->skybox, skyboxVAO, programState->inner_cubemapTexture);
+                drawCube(shader->cube);
+                updateInSpace();
+            }
 
-        // HDR & BLOOM
+            // MODELS
+            // diamonds models
+
+            // the cube is already in the depth buffer, so everything inside it is tested against its walls
+            if (!halfResTransparency)
+                drawDiamond();
+
+            // planet models
+            if (!deferred)
+                drawPlanets(false);
+
+            // transparent windows
+            if (!halfResTransparency)
+                drawWindows();
+
+            // SKY_BOXES
+            drawSky();
+        });
+        if (deferred)
+            sceneColor = scenePass.write(sceneColor);
+        else if (msaa)
+            sceneColor = scenePass.create("msaa scene", {hdrFormat, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, 4});
+        else if (taa)
+            sceneColor = scenePass.create("hdr + velocity", {hdrFormat, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, 0, {GL_RG16F}});
+        else
+            sceneColor = scenePass.create("hdr", {hdrFormat, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, 0});
+
+        RenderGraph::Resource hdr = sceneColor;
+        if (msaa) {
+            RenderGraph::Builder resolvePass = graph.addPass("msaa resolve", [&](const RenderGraph::Registry &registry) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, registry.target(sceneColor).fbo);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, registry.target(hdr).fbo);
+                // depth too, temporal bloom reprojects with it
+                glBlitFramebuffer(0, 0, sceneSize.x, sceneSize.y, 0, 0, sceneSize.x, sceneSize.y,
+                                  GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            });
+            resolvePass.read(sceneColor);
+            hdr = resolvePass.create("hdr", {hdrFormat, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, 0});
+        }
 
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        shader->blur.use();
+        // half resolution transparency: the scene depth is downsampled into the layer's depth buffer
+        // and the transparent geometry is tested against it without writing it, so the post pass can
+        // compare both depths in its bilateral upsample. The layer starts with nothing in front of the
+        // scene, premultiplied color 0 and transmittance 1.
+        RenderGraph::Resource transparency = -1;
+        glm::ivec2 layerSize = (sceneSize + 1) / 2;
+        if (halfResTransparency) {
+            RenderGraph::Builder transparencyPass = graph.addPass("transparency (half)", [&](const RenderGraph::Registry &registry) {
+                RenderTarget &layer = registry.target(transparency);
+                glBindFramebuffer(GL_FRAMEBUFFER, layer.fbo);
+                glViewport(0, 0, layerSize.x, layerSize.y);
+                glBindBufferRange(GL_UNIFORM_BUFFER, MATRICES_BLOCK, frameData.buffer(), unjitteredOffset, sizeof(matrices));
+
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                glDepthFunc(GL_ALWAYS);
+                shader->depthDownsample.use();
+                shader->depthDownsample.setInt("depth", 0);
+                shader->depthDownsample.setVec2("lastTexel", glm::vec2(sceneSize - 1));
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, registry.target(hdr).depthTexture);
+                renderQuad();
+                glDepthFunc(GL_LESS);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+                glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                glDepthMask(GL_FALSE);
+                glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+                drawDiamond();
+                drawWindows();
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glDepthMask(GL_TRUE);
+                glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+                glBindBufferRange(GL_UNIFORM_BUFFER, MATRICES_BLOCK, frameData.buffer(), matricesOffset, sizeof(matrices));
+            });
+            transparencyPass.read(hdr);
+            transparency = transparencyPass.create("transparency", {GL_RGBA16F, (framebufferWidth + 1) / 2, (framebufferHeight + 1) / 2,
+                                                                    GL_DEPTH_COMPONENT24, 0});
+        }
 
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            shader->blur.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        // TAA: the jittered scene accumulated into a history at full resolution, which the post pass reads
+        // instead of the scene; the history stays with the upsampler
+        RenderGraph::Resource upsampled = -1;
+        if (taa) {
+            RenderGraph::Builder taaPass = graph.addPass("taa upsample", [&](const RenderGraph::Registry &registry) {
+                RenderTarget *history = temporalAA.resolve(registry.target(hdr), sceneScale, glm::ivec2(framebufferWidth, framebufferHeight),
+                                                           projection * view, programState->previousViewProjection);
+                registry.provide(upsampled, history, false);
+            });
+            taaPass.read(hdr);
+            upsampled = taaPass.provided("taa history");
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shader->bloom.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        shader->bloom.setInt("bloom", bloom);
-        shader->bloom.setFloat("exposure", exposure);
-        renderQuad();
+        // the bright pass and blur chain allocate their own targets from the pool, the temporal
+        // history stays with the bloom. Under TAA the glow is made from the resolved history, the
+        // jittered scene would make it shimmer; the depth for the reprojection still is the scene's
+        RenderGraph::Resource glow;
+        // named after the mode, so the GPU timings tell the two apart
+        RenderGraph::Builder bloomPass = graph.addPass(programState->bloomEffect.temporal ? "bloom (temporal)" : "bloom", [&](const RenderGraph::Registry &registry) {
+            Bloom &bloomEffect = programState->bloomEffect;
+            bloomEffect.setView(projection * view, registry.target(hdr).depthTexture, sceneScale);
+            RenderTarget *glowTarget = taa ? bloomEffect.render(registry.target(upsampled), glm::vec2(1.0f))
+                                           : bloomEffect.render(registry.target(hdr), sceneScale);
+            registry.provide(glow, glowTarget, !bloomEffect.keepsResult());
+        });
+        bloomPass.read(hdr);
+        if (taa)
+            bloomPass.read(upsampled);
+        glow = bloomPass.provided("bloom");
+        // the culled pass never renders, its history would stay acquired from the pool
+        if (!bloom)
+            programState->bloomEffect.releaseHistory();
+
+        // the post pass upscales the scene to the whole framebuffer, it covers every pixel so
+        // there is nothing to clear
+        RenderGraph::Builder postPass = graph.addPass(antiAliasing == AA_FXAA ? "post + fxaa" : "post", [&](const RenderGraph::Registry &registry) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, framebufferWidth, framebufferHeight);
+            programState->postProcess.fxaa = antiAliasing == AA_FXAA;
+            if (halfResTransparency)
+                programState->postProcess.setTransparency(registry.target(transparency).texture, registry.target(transparency).depthTexture,
+                                                          registry.target(hdr).depthTexture, sceneScale, glm::vec2(NEAR_PLANE, FAR_PLANE));
+            else
+                programState->postProcess.setTransparency(0, 0, 0, sceneScale, glm::vec2(NEAR_PLANE, FAR_PLANE));
+            // the TAA history covers its whole target
+            unsigned int sceneTexture = taa ? registry.target(upsampled).texture : registry.target(hdr).texture;
+            programState->postProcess.render(sceneTexture, taa ? glm::vec2(1.0f) : sceneScale, bloom ? registry.target(glow).texture : 0,
+                                             programState->bloomEffect.strength(), exposure,
+                                             glm::ivec2(framebufferWidth, framebufferHeight));
+        });
+        postPass.read(taa ? upsampled : hdr);
+        // the transparency composite compares against the scene depth
+        if (halfResTransparency) {
+            postPass.read(transparency);
+            if (taa)
+                postPass.read(hdr);
+        }
+        // with bloom off nothing reads the glow, there is no bright pass and no blur at all
+        if (bloom)
+            postPass.read(glow);
+        screen = postPass.write(screen);
 
         //ImGui
+        RenderGraph::Builder imguiPass = graph.addPass("imgui", [&](const RenderGraph::Registry &) {
+            if (programState->ImGui1Enable || programState->ImGui2Enable) {
+                drawImGui();
+            }
+        });
+        screen = imguiPass.write(screen);
 
-        if (programState->ImGui1Enable || programState->ImGui2Enable) {
-            drawImGui();
-        }
+        graph.compile();
+        graph.execute(&gpuTimer);
+
+        programState->previousViewProjection = projection * view;
+        previousModels[SceneObject::DIAMOND] = diamondMatrix;
+        previousModels[SceneObject::MARS] = marsMatrix;
+        previousModels[SceneObject::VENUS] = venusMatrix;
+        previousModels[SceneObject::SUN] = sunMatrix;
+        programState->hasPreviousFrame = true;
+
+        frameData.endFrame();
+        gpuTimer.endFrame();
+        dynamicResolution.endFrame();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -762,6 +1218,9 @@ void processInput(GLFWwindow *window) {
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
+    // the offscreen targets follow on the next frame
+    framebufferWidth = width;
+    framebufferHeight = height;
     glViewport(0, 0, width, height);
 }
 
@@ -852,24 +1311,35 @@ unsigned int loadTexture(char const * path)
     return textureID;
 }
 
-void drawModel(Model obj_model, Shader m_shader, const std::vector<glm::vec3>& translations, glm::vec3 rotation, glm::vec3 scale, glm::mat4 projection, glm::mat4 view) {
+glm::mat4 modelMatrix(const std::vector<glm::vec3>& translations, glm::vec3 rotation, glm::vec3 scale, float angle) {
     glm::mat4 model = glm::mat4(1.0f);
 
     for (auto &translation : translations) {
         model = glm::translate(model, translation);
     }
 
-    model = glm::rotate(model, (float)glfwGetTime(), rotation);
+    model = glm::rotate(model, angle, rotation);
     model = glm::scale(model, scale);
+    return model;
+}
+
+void drawModel(Model &obj_model, Shader &m_shader, const glm::mat4 &model, const glm::mat4 &previousModel, glm::mat4 projection) {
+    // fraction of the screen height covered by the bounding sphere, projection[1][1] is 1 / tan(fov / 2)
+    BoundingSphere sphere = obj_model.sphere.transformed(model);
+    float distance = glm::distance(sphere.center, programState->camera.Position);
+    float screenSize = distance > sphere.radius ? sphere.radius * projection[1][1] / distance : 1.0f;
+    obj_model.SelectLod(screenSize);
 
     m_shader.use();
-    m_shader.setMat4("projection", projection);
-    m_shader.setMat4("view", view);
-    m_shader.setMat4("model", model);
+    setModelMatrix(model, previousModel);
 
     stbi_set_flip_vertically_on_load(true);
-    obj_model.Draw(m_shader);
+    unsigned int drawn = obj_model.Draw(m_shader, programState->frustum, model);
     stbi_set_flip_vertically_on_load(false);
+
+    programState->meshesDrawn += drawn;
+    programState->trianglesDrawn += obj_model.trianglesDrawn;
+    programState->meshesCulled += obj_model.meshes.size() - drawn;
 }
 
 void loadFaces(std::vector<std::string> &faces, const std::string& dirName) {
@@ -907,6 +1377,85 @@ void drawImGui() {
             ImGui::DragFloat("<- Diamond scale", &programState->diamondScale, 0.01f, 0.0, 2.2);
             ImGui::Text("\n\nUkoliko zelite mozete da menjate i transparentnost dijamanta:\n\n");
             ImGui::DragFloat("<- Diamond transparent", &programState->diamondTransparent, 0.005f, 0.0, 1.0);
+            ImGui::Text("\n\nObjects visible: %d / %d, tree height: %d", (int)std::count(programState->objectVisible, programState->objectVisible + SceneObject::COUNT, true),
+                        (int)SceneObject::COUNT, programState->sceneTree.height());
+            ImGui::Text("Meshes drawn: %u, culled: %u", programState->meshesDrawn, programState->meshesCulled);
+            ImGui::Text("Model triangles: %u (LOD mars %u, venus %u, sun %u)", programState->trianglesDrawn,
+                        programState->mars.lod, programState->venus.lod, programState->sun.lod);
+
+            int occlusionMode = programState->occlusion.mode;
+            ImGui::Combo("<- Occlusion", &occlusionMode, "Off\0Conditional render\0Previous frame\0");
+            programState->occlusion.mode = (OcclusionCuller::Mode)occlusionMode;
+            ImGui::Text("Occluded objects: %u (%s queries)", programState->occlusion.occludedCount(),
+                        programState->occlusion.conservative() ? "conservative" : "exact");
+            ImGui::Text("Uniform ring buffer: %s", programState->frameData.persistent() ? "persistent mapping" : "orphaning");
+            int extraLights = (int)programState->pointLights.size() - SCENE_POINT_LIGHTS;
+            if (ImGui::SliderInt("<- Extra point lights", &extraLights, 0, 512))
+                setExtraLightCount(extraLights);
+            const ClusteredLights &lightClusters = programState->lightClusters;
+            ImGui::Text("Clustered lights: %u, %u cluster entries", (unsigned int)lightClusters.lightCount(),
+                        (unsigned int)lightClusters.listedCount());
+            ImGui::Text("Lights per lit cluster: %.1f average, %u at most, %u dropped", lightClusters.averageClusterLights(),
+                        (unsigned int)lightClusters.maxClusterLights(), (unsigned int)lightClusters.droppedCount());
+
+            Bloom &bloomEffect = programState->bloomEffect;
+            int bloomMode = bloomEffect.mode;
+            ImGui::Combo("<- Bloom filter", &bloomMode, "Dual filter\0Gaussian\0");
+            bloomEffect.mode = (Bloom::Mode)bloomMode;
+            ImGui::SliderInt("<- Bloom mips", &bloomEffect.mipCount, 1, Bloom::MAX_MIPS);
+            ImGui::DragFloat("<- Bloom radius", &bloomEffect.radius, 0.05f, 0.5f, 4.0f);
+            ImGui::DragFloat("<- Bloom threshold", &bloomEffect.threshold, 0.05f, 0.0f, 10.0f);
+            int quarter = bloomEffect.resolutionDivisor == 4;
+            ImGui::Combo("<- Bright pass", &quarter, "Half resolution\0Quarter resolution\0");
+            bloomEffect.resolutionDivisor = quarter ? 4 : 2;
+            if (shader->blurCompute.valid())
+                ImGui::Checkbox("Compute gaussian blur", &bloomEffect.computeBlur);
+            else
+                ImGui::Text("Gaussian blur: fragment fallback (no GL 4.3)");
+            ImGui::Checkbox("Temporal bloom (chain every other frame)", &bloomEffect.temporal);
+            if (bloomEffect.temporal)
+                ImGui::DragFloat("<- Bloom history weight", &bloomEffect.historyWeight, 0.01f, 0.0f, 0.9f);
+            PostProcess &postProcess = programState->postProcess;
+            int aaMode = antiAliasing;
+            ImGui::Combo("<- Anti-aliasing", &aaMode, "Off\0FXAA\0MSAA 4x\0TAA upsample\0");
+            antiAliasing = (AntiAliasing)aaMode;
+            if (antiAliasing == AA_TAA) {
+                ImGui::SliderFloat("<- TAA render scale", &programState->temporalAA.renderScale, 0.5f, 1.0f);
+                ImGui::SliderFloat("<- TAA feedback", &programState->temporalAA.feedback, 0.5f, 0.97f);
+            }
+            ImGui::Checkbox("Half resolution transparency", &halfResTransparency);
+            ImGui::Checkbox("Deferred opaque shading (not with MSAA)", &deferredShading);
+            ImGui::Checkbox("Vignette", &postProcess.vignette);
+            ImGui::Checkbox("Gamma correction", &postProcess.gammaCorrect);
+            ImGui::Text("Post programs compiled: %u", (unsigned int)postProcess.programCount());
+            std::string graphPasses;
+            for (const RenderGraph::PassInfo &pass : programState->renderGraph.lastPasses()) {
+                graphPasses += std::string(graphPasses.empty() ? "" : ", ") + pass.name + (pass.culled ? " (culled)" : "");
+            }
+            ImGui::Text("Render graph: %s", graphPasses.c_str());
+            ImGui::Text("Transient targets: %u", (unsigned int)programState->renderGraph.lastTransientCount());
+            ImGui::Text("GPU time per pass:");
+            for (const GpuTimer::Section &section : programState->gpuTimer.results()) {
+                ImGui::Text("  %s: %.3f ms", section.name.c_str(), section.ms);
+            }
+
+            int packedFormat = hdrFormat == GL_R11F_G11F_B10F ? 0 : 1;
+            ImGui::Combo("<- HDR format", &packedFormat, "R11F_G11F_B10F\0RGBA16F\0");
+            hdrFormat = packedFormat == 0 ? GL_R11F_G11F_B10F : GL_RGBA16F;
+
+            DynamicResolution &dynamicResolution = programState->dynamicResolution;
+            ImGui::Checkbox("Dynamic resolution", &dynamicResolution.enabled);
+            ImGui::DragFloat("<- Target GPU ms", &dynamicResolution.targetMs, 0.1f, 2.0f, 50.0f);
+            ImGui::Text("GPU frame: %.2f ms, scene scale %.0f%%", dynamicResolution.gpuMs(), dynamicResolution.scale() * 100.0f);
+            ImGui::Text("Render targets: %u, %.1f MB at %dx%d", (unsigned int)programState->renderTargets.targetCount(),
+                        programState->renderTargets.bytes() / (1024.0f * 1024.0f), framebufferWidth, framebufferHeight);
+
+            ImGui::Text("\nGeometry memory (CPU / GPU):");
+            const char *modelNames[] = {"diamond", "pink diamond", "mars", "venus", "sun"};
+            const Model *models[] = {&programState->diamond, &programState->pink_diamond, &programState->mars, &programState->venus, &programState->sun};
+            for (int i = 0; i < 5; i++) {
+                ImGui::Text("  %s: %.1f KB / %.1f KB", modelNames[i], models[i]->CpuBytes() / 1024.0f, models[i]->GpuBytes() / 1024.0f);
+            }
             ImGui::End();
         }
     }
@@ -929,14 +1478,35 @@ void drawImGui() {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+// per draw model matrix, goes through the ring buffer like the camera matrices
+void setModelMatrix(const glm::mat4 &model) {
+    setModelMatrix(model, model);
+}
+
+void setModelMatrix(const glm::mat4 &model, const glm::mat4 &previousModel) {
+    RingBuffer &frameData = programState->frameData;
+    ObjectMatrices matrices = {model, previousModel};
+    GLintptr offset = frameData.upload(&matrices, sizeof(matrices));
+    glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK, frameData.buffer(), offset, sizeof(matrices));
+}
+
+void bindUniformBlocks(const Shader &objShader) {
+    unsigned int matrices = glGetUniformBlockIndex(objShader.ID, "Matrices");
+    if (matrices != GL_INVALID_INDEX) {
+        glUniformBlockBinding(objShader.ID, matrices, MATRICES_BLOCK);
+    }
+
+    unsigned int object = glGetUniformBlockIndex(objShader.ID, "Object");
+    if (object != GL_INVALID_INDEX) {
+        glUniformBlockBinding(objShader.ID, object, OBJECT_BLOCK);
+    }
+}
+
 void drawSkyBox(Shader objShader, unsigned int objVAO, unsigned int texture) {
     glDepthMask(GL_FALSE);
     glDepthFunc(GL_LEQUAL);
     objShader.use();
 
-    objShader.setMat4("view", glm::mat4(glm::mat3(programState->camera.GetViewMatrix())));
-    objShader.setMat4("projection", glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f , 100.0f));
-
     glBindVertexArray(objVAO);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
@@ -970,40 +1540,11 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 }
 
 void setDiamondLightsShader(Shader objShader, PointLight pointLight, DirLight dirLight, SpotLight spotLight) {
-    double time = glfwGetTime();
-
     objShader.use();
-    objShader.setVec3("pointLights[0].position",  glm::vec3(2.0f * cos(time), 4.0f, 4*sin(time)));
-    objShader.setVec3("pointLights[0].ambient",  pointLight.ambient);
-    objShader.setVec3("pointLights[0].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[0].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[0].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[0].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[0].quadratic",  pointLight.quadratic);
-
-    objShader.setVec3("pointLights[1].position",  glm::vec3(1.0f * cos(time), -4.0f, 3*sin(time)));
-    objShader.setVec3("pointLights[1].ambient",  pointLight.ambient);
-    objShader.setVec3("pointLights[1].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[1].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[1].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[1].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[1].quadratic",  pointLight.quadratic);
-
-    objShader.setVec3("pointLights[2].position",  programState->pointLightsPositions[2]);
-    objShader.setVec3("pointLights[2].ambient",  pointLight.ambient);
-    objShader.setVec3("pointLights[2].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[2].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[2].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[2].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[2].quadratic",  pointLight.quadratic);
-
-    objShader.setVec3("pointLights[3].position",  programState->pointLightsPositions[3]);
-    objShader.setVec3("pointLights[3].ambient",  pointLight.ambient);
-    objShader.setVec3("pointLights[3].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[3].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[3].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[3].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[3].quadratic",  pointLight.quadratic);
+    // the point lights come from the clusters, looked up in the viewport being drawn into
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    programState->lightClusters.bind(objShader, glm::ivec2(viewport[2], viewport[3]), LIGHT_BUFFER_UNIT);
 
     objShader.setVec3("dirLight.direction", dirLight.direction);
     objShader.setVec3("dirLight.ambient", dirLight.ambient);
@@ -1026,40 +1567,10 @@ void setDiamondLightsShader(Shader objShader, PointLight pointLight, DirLight di
 }
 
 void setLightsShader(Shader objShader, PointLight pointLight, DirLight dirLight, SpotLight spotLight, glm::vec3 dirLightDiffuse, glm::vec3 dirLightAmbient) {
-    double time = glfwGetTime();
-
     objShader.use();
-    objShader.setVec3("pointLights[0].position", glm::vec3(-2.f * cos(time), -2.0f * cos(time), -5.f * sin(time) / 2));
-    objShader.setVec3("pointLights[0].ambient",  glm::vec3(0.05f));
-    objShader.setVec3("pointLights[0].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[0].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[0].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[0].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[0].quadratic",  pointLight.quadratic);
-
-    objShader.setVec3("pointLights[1].position",  glm::vec3(1.0f * cos(time), -4.0f, 3*sin(time)));
-    objShader.setVec3("pointLights[1].ambient",  glm::vec3(0.05f));
-    objShader.setVec3("pointLights[1].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[1].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[1].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[1].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[1].quadratic",  pointLight.quadratic);
-
-    objShader.setVec3("pointLights[2].position",  glm::vec3(0.f, 3.5f * cos(time) , -2.0f * sin(time) / 2));
-    objShader.setVec3("pointLights[2].ambient",  pointLight.ambient);
-    objShader.setVec3("pointLights[2].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[2].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[2].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[2].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[2].quadratic",  pointLight.quadratic);
-
-    objShader.setVec3("pointLights[3].position",  programState->pointLightsPositions[3]);
-    objShader.setVec3("pointLights[3].ambient",  pointLight.ambient);
-    objShader.setVec3("pointLights[3].diffuse",  pointLight.diffuse);
-    objShader.setVec3("pointLights[3].specular",  pointLight.specular);
-    objShader.setFloat("pointLights[3].constant",  pointLight.constant);
-    objShader.setFloat("pointLights[3].linear",  pointLight.linear);
-    objShader.setFloat("pointLights[3].quadratic",  pointLight.quadratic);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    programState->lightClusters.bind(objShader, glm::ivec2(viewport[2], viewport[3]), LIGHT_BUFFER_UNIT);
 
     objShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
     objShader.setVec3("dirLight.ambient", dirLightAmbient);
@@ -1081,6 +1592,76 @@ void setLightsShader(Shader objShader, PointLight pointLight, DirLight dirLight,
     objShader.setFloat("material.shininess", 32.0f);
 }
 
+// lighting pass of the deferred path: the terms of setLightsShader, with the directional light colors
+// of every planet so one pass can light all of them
+void setDeferredLightingShader(Shader &objShader, const glm::mat4 &inverseViewProjection, glm::ivec2 viewportSize) {
+    objShader.use();
+    programState->lightClusters.bind(objShader, viewportSize, LIGHT_BUFFER_UNIT);
+
+    objShader.setVec3("dirLightDirection", -0.2f, -1.0f, -0.3f);
+    objShader.setVec3("dirLightSpecular", 0.25f, 0.25f, 0.25f);
+    for (int i = 0; i < DEFERRED_MATERIALS; i++) {
+        objShader.setVec3("dirLightDiffuse[" + std::to_string(i) + "]", PLANET_DIR_LIGHT_DIFFUSE[i]);
+        objShader.setVec3("dirLightAmbient[" + std::to_string(i) + "]", PLANET_DIR_LIGHT_AMBIENT[i]);
+    }
+
+    objShader.setVec3("spotLight.position", programState->camera.Position);
+    objShader.setVec3("spotLight.direction", programState->camera.Front);
+    objShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
+    objShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
+    objShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
+    objShader.setFloat("spotLight.constant", 1.0f);
+    objShader.setFloat("spotLight.linear", 0.09);
+    objShader.setFloat("spotLight.quadratic", 0.032);
+    objShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+    objShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+
+    objShader.setVec3("viewPos", programState->camera.Position);
+    objShader.setMat4("inverseViewProjection", inverseViewProjection);
+    objShader.setVec2("viewportSize", glm::vec2(viewportSize));
+}
+
+// the lights of the scene: two orbiting above and below the diamond and two fixed ones behind it
+void initPointLights() {
+    const PointLight &pointLight = programState->pointLight;
+    auto add = [&](glm::vec3 center, glm::vec3 cosAxis, glm::vec3 sinAxis) {
+        programState->pointLights.add(center, cosAxis, sinAxis, pointLight.ambient, pointLight.diffuse, pointLight.specular,
+                                      pointLight.constant, pointLight.linear, pointLight.quadratic);
+    };
+    add(glm::vec3(0.0f, 4.0f, 0.0f), glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 4.0f));
+    add(glm::vec3(0.0f, -4.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 3.0f));
+    add(glm::vec3(-4.0f, 2.0f, -12.0f), glm::vec3(0.0f), glm::vec3(0.0f));
+    add(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(0.0f), glm::vec3(0.0f));
+}
+
+// once per frame: the scene lights take the colors of the bling switch, then everything is animated,
+// packed and sorted into the clusters of the camera
+void updatePointLights(float time, const glm::mat4 &view, const glm::mat4 &projection) {
+    const PointLight &pointLight = programState->pointLight;
+    LightSystem &pointLights = programState->pointLights;
+    pointLights.setColors(0, SCENE_POINT_LIGHTS, pointLight.ambient, pointLight.diffuse, pointLight.specular);
+    pointLights.update(time);
+    programState->lightClusters.update(pointLights.packedLights(), view, projection, NEAR_PLANE, FAR_PLANE);
+}
+
+// extra lights spiral around the diamond through the space inside the cube; small coloured lights
+// without ambient, so a lot of them do not wash the scene out
+void setExtraLightCount(int count) {
+    LightSystem &pointLights = programState->pointLights;
+    pointLights.resize(SCENE_POINT_LIGHTS);
+    for (int i = 0; i < count; i++) {
+        float angle = (float)i * 2.39996f;
+        float radius = 2.5f + (float)(i % 7) * 0.8f;
+        float height = ((float)((i * 37) % 101) / 100.0f - 0.5f) * 8.0f;
+        float hue = (float)((SCENE_POINT_LIGHTS + i) * 0.618034) * 6.0f;
+        glm::vec3 color = glm::clamp(glm::vec3(std::abs(std::fmod(hue, 6.0f) - 3.0f) - 1.0f,
+                                               2.0f - std::abs(std::fmod(hue + 4.0f, 6.0f) - 3.0f),
+                                               2.0f - std::abs(std::fmod(hue + 2.0f, 6.0f) - 3.0f)), 0.0f, 1.0f);
+        pointLights.add(glm::vec3(radius * cos(angle), height, radius * sin(angle)), glm::vec3(0.0f), glm::vec3(0.0f),
+                        glm::vec3(0.0f), color, color * 0.3f, 1.0f, 0.7f, 1.8f, EXTRA_LIGHT_RADIUS);
+    }
+}
+
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
 void renderQuad()